@@ -0,0 +1,447 @@
+//
+// oblivious algorithms on SHEVectors
+//
+#ifndef SHEAlgorithm_H_
+#define SHEAlgorithm_H_ 1
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include <NTL/BasicThreadPool.h>
+#include "SHEInt.h"
+#include "SHEVector.h"
+#include "SHELinear.h"
+
+//
+// Sorting uses Batcher's odd-even merge sort network. The network only
+// depends on the size of the vector, so it is built in the clear, and
+// every compare-and-swap in a layer is independent of the others. A
+// vector of n elements takes about log2(n)^2/2 layers and
+// n*log2(n)^2/4 compare-and-swaps, against the n^2/2 compare-and-swaps and
+// n layers of a bubble sort. Each layer brings the whole vector up to
+// capacity in one packed recrypt pass before it starts, then runs its
+// compare-and-swaps on the NTL thread pool (see SHEInt::setThreads()).
+//
+// topK() and median() run the same network pruned back from the outputs
+// they need: a comparator that can't reach one of them is dropped, and a
+// comparator where only one side is needed only does one select. The top
+// one element is the n-1 comparators of a linear max.
+//
+// T can be any type with operator< returning an encrypted bool and a
+// select(SHEInt, T, T) function (SHEInt, SHEFp, SHEFixed, SHEString and
+// their subclasses).
+//
+struct SHESortComparator {
+  int low;          // index that gets the smaller (first) value
+  int high;         // index that gets the larger (second) value
+  bool keepLow;
+  bool keepHigh;
+};
+typedef std::vector<SHESortComparator> SHESortLayer;
+
+// the full odd-even merge sort network for n elements
+inline std::vector<SHESortLayer> sheSortNetwork(int n)
+{
+  std::vector<SHESortLayer> layers;
+  for (int p=1; p < n; p <<= 1) {
+    for (int k=p; k >= 1; k >>= 1) {
+      SHESortLayer layer;
+      for (int j=k%p; j+k < n; j += 2*k) {
+        for (int i=0; i < std::min(k, n-j-k); i++) {
+          if ((i+j)/(2*p) == (i+j+k)/(2*p)) {
+            layer.push_back({i+j, i+j+k, true, true});
+          }
+        }
+      }
+      if (layer.size()) {
+        layers.push_back(layer);
+      }
+    }
+  }
+  return layers;
+}
+
+// drop the comparators that can't reach any of the needed outputs
+inline std::vector<SHESortLayer> sheSortPrune(
+                                        const std::vector<SHESortLayer> &net,
+                                        int n, const std::vector<int> &needed)
+{
+  std::vector<bool> need(n, false);
+  for (auto index : needed) {
+    need[index] = true;
+  }
+  std::vector<SHESortLayer> layers(net.size());
+  for (int l=net.size()-1; l >= 0; l--) {
+    for (auto comp : net[l]) {
+      if (!need[comp.low] && !need[comp.high]) {
+        continue;
+      }
+      comp.keepLow = need[comp.low];
+      comp.keepHigh = need[comp.high];
+      layers[l].push_back(comp);
+    }
+    for (auto &comp : layers[l]) {
+      need[comp.low] = need[comp.high] = true;
+    }
+  }
+  std::vector<SHESortLayer> result;
+  for (auto &layer : layers) {
+    if (layer.size()) {
+      result.push_back(layer);
+    }
+  }
+  return result;
+}
+
+// run a network over keys, moving values (if any) along with them. No
+// index appears in more than one comparator of a layer, so each
+// comparator can compare and swap on its own.
+template<class K, class V>
+inline void sheSortRun(const std::vector<SHESortLayer> &net,
+                       SHEVector<K> &keys, SHEVector<V> *values,
+                       bool descending)
+{
+  for (auto &layer : net) {
+    keys.verifyArgs();
+    if (values) {
+      values->verifyArgs();
+    }
+    NTL_EXEC_RANGE(layer.size(), first, last)
+    for (long c=first; c < last; c++) {
+      const SHESortComparator &comp = layer[c];
+      K a(keys[comp.low]);
+      K b(keys[comp.high]);
+      SHEInt swap(descending ? SHEInt(a < b) : SHEInt(b < a));
+      if (comp.keepLow) {
+        keys[comp.low] = select(swap, b, a);
+      }
+      if (comp.keepHigh) {
+        keys[comp.high] = select(swap, a, b);
+      }
+      if (values) {
+        V va((*values)[comp.low]);
+        V vb((*values)[comp.high]);
+        if (comp.keepLow) {
+          (*values)[comp.low] = select(swap, vb, va);
+        }
+        if (comp.keepHigh) {
+          (*values)[comp.high] = select(swap, va, vb);
+        }
+      }
+    }
+    NTL_EXEC_RANGE_END
+  }
+}
+
+template<class T>
+inline void sort(SHEVector<T> &v, bool descending=false)
+{
+  sheSortRun<T,T>(sheSortNetwork(v.size()), v, nullptr, descending);
+}
+
+// sort values by keys (not sort(), which std::sort would make ambiguous)
+template<class K, class V>
+inline void sortBy(SHEVector<K> &keys, SHEVector<V> &values,
+                   bool descending=false)
+{
+  helib::assertTrue(keys.size() == values.size(),
+                    "sort keys and values must be the same size");
+  sheSortRun<K,V>(sheSortNetwork(keys.size()), keys, &values, descending);
+}
+
+// the k largest elements, largest first
+template<class T>
+inline SHEVector<T> topK(const SHEVector<T> &v, int k)
+{
+  helib::assertTrue((k > 0) && (k <= v.size()), "topK k out of range");
+  std::vector<int> needed;
+  for (int i=0; i < k; i++) {
+    needed.push_back(i);
+  }
+  SHEVector<T> work(v);
+  sheSortRun<T,T>(sheSortPrune(sheSortNetwork(v.size()), v.size(), needed),
+                  work, nullptr, true);
+  work.resize(k);
+  return work;
+}
+
+// the values of the k largest keys, largest first
+template<class K, class V>
+inline SHEVector<V> topK(const SHEVector<K> &keys, const SHEVector<V> &values,
+                         int k)
+{
+  helib::assertTrue(keys.size() == values.size(),
+                    "topK keys and values must be the same size");
+  helib::assertTrue((k > 0) && (k <= keys.size()), "topK k out of range");
+  std::vector<int> needed;
+  for (int i=0; i < k; i++) {
+    needed.push_back(i);
+  }
+  SHEVector<K> work(keys);
+  SHEVector<V> result(values);
+  sheSortRun<K,V>(sheSortPrune(sheSortNetwork(keys.size()), keys.size(),
+                               needed), work, &result, true);
+  result.resize(k);
+  return result;
+}
+
+// the lower median, element (n-1)/2 of the sorted vector
+template<class T>
+inline T median(const SHEVector<T> &v)
+{
+  helib::assertTrue(v.size() > 0, "median of an empty vector");
+  int middle = (v.size()-1)/2;
+  SHEVector<T> work(v);
+  sheSortRun<T,T>(sheSortPrune(sheSortNetwork(v.size()), v.size(),
+                               std::vector<int>(1, middle)),
+                  work, nullptr, false);
+  return work[middle];
+}
+
+//
+// max(), min(), argmax() and argmin() reduce the vector as a tournament.
+// Each round compares disjoint pairs, so n elements take n-1 compares in
+// ceil(log2(n)) rounds, where folding SHEMAX down the vector is a chain of
+// n-1. The arg versions carry the encrypted index of each survivor with
+// its value. Ties go to the lower index. These need T to have
+// getPublicKey() as well (SHEInt, SHEFp and SHEFixed).
+//
+template<class T>
+inline T sheTournament(const SHEVector<T> &v, bool wantMax, SHEInt *index)
+{
+  helib::assertTrue(v.size() > 0, "reduction of an empty vector");
+  int bits = SHEInt::getBitSize(v.size()-1);
+  SHEInt zero(v[0].getPublicKey(), (uint64_t)0, bits, true);
+  SHEVector<T> value(v);
+  SHEVector<SHEInt> position(zero, 0);
+  bool first = true;
+  while (value.size() > 1) {
+    value.verifyArgs();
+    if (index && !first) {
+      position.verifyArgs();
+    }
+    SHEVector<T> nextValue(value[0], 0);
+    SHEVector<SHEInt> nextPosition(zero, 0);
+    for (int i=0; i+1 < value.size(); i += 2) {
+      SHEInt sel = wantMax ? SHEInt(value[i] < value[i+1])
+                           : SHEInt(value[i+1] < value[i]);
+      nextValue.push_back(select(sel, value[i+1], value[i]));
+      if (!index) {
+        continue;
+      }
+      SHEInt pos(first ? select(sel, (uint64_t)i+1, (uint64_t)i)
+                       : select(sel, position[i+1], position[i]));
+      pos.reset(bits, true);
+      nextPosition.push_back(pos);
+    }
+    if (value.size() & 1) {
+      nextValue.push_back(value.back());
+      if (index) {
+        nextPosition.push_back(first ?
+                SHEInt(zero.getPublicKey(), (uint64_t)value.size()-1,
+                       bits, true) : position.back());
+      }
+    }
+    value = nextValue;
+    position = nextPosition;
+    first = false;
+  }
+  if (index) {
+    *index = position.size() ? position[0] : zero;
+  }
+  return value[0];
+}
+
+template<class T>
+inline T max(const SHEVector<T> &v)
+{ return sheTournament(v, true, nullptr); }
+template<class T>
+inline T min(const SHEVector<T> &v)
+{ return sheTournament(v, false, nullptr); }
+template<class T>
+inline SHEInt argmax(const SHEVector<T> &v)
+{
+  SHEInt index(v[0].getPublicKey());
+  sheTournament(v, true, &index);
+  return index;
+}
+template<class T>
+inline SHEInt argmin(const SHEVector<T> &v)
+{
+  SHEInt index(v[0].getPublicKey());
+  sheTournament(v, false, &index);
+  return index;
+}
+
+//
+// Prefix scans use the Ladner-Fischer (Sklansky) network: at level d every
+// element with bit d of its index set combines with the last element of
+// the block of 2^d just before it. That is ceil(log2(n)) levels of n/2
+// independent operations, against the n-1 level chain of a running total.
+// Each level is recrypted in one packed pass before it starts, then its
+// operations run on the NTL thread pool, so op may be called from several
+// threads at once. The operator must be associative, but not necessarily
+// commutative, op(a,b) is always called with a the earlier element. op can
+// be a lambda, T is taken from the vector.
+//
+enum SHEScanOp {
+  SHEScanAdd,
+  SHEScanMax,
+  SHEScanMin,
+  SHEScanOr,   // SHEInt only
+  SHEScanAnd   // SHEInt only
+};
+
+// T in a parameter that shouldn't take part in deducing T
+template<class T>
+struct SHEIdentity { typedef T type; };
+template<class T>
+using SHEScanFunction =
+        typename SHEIdentity<std::function<T(const T &, const T &)>>::type;
+
+template<class T>
+inline SHEScanFunction<T> sheScanFunction(SHEScanOp op)
+{
+  switch (op) {
+  case SHEScanAdd:
+    return [](const T &a, const T &b) { return T(a+b); };
+  case SHEScanMax:
+    return [](const T &a, const T &b) { return T(select(a < b, b, a)); };
+  case SHEScanMin:
+    return [](const T &a, const T &b) { return T(select(b < a, b, a)); };
+  default:
+    break;
+  }
+  if constexpr (std::is_base_of<SHEInt, T>::value) {
+    if (op == SHEScanOr) {
+      return [](const T &a, const T &b) { return T(a|b); };
+    }
+    if (op == SHEScanAnd) {
+      return [](const T &a, const T &b) { return T(a&b); };
+    }
+  }
+  throw helib::LogicError("scan operation not supported on this type");
+}
+
+// result[i] = v[0] op v[1] op ... op v[i]
+template<class T>
+inline SHEVector<T> inclusiveScan(const SHEVector<T> &v,
+                                  const SHEScanFunction<T> &op)
+{
+  SHEVector<T> result(v);
+  for (int d=1; d < result.size(); d <<= 1) {
+    result.verifyArgs();
+    // the sources have bit d clear, so none of them change in this level
+    NTL_EXEC_RANGE(result.size(), first, last)
+    for (long i=first; i < last; i++) {
+      if (i & d) {
+        result[i] = op(result[(i & ~(2*d-1)) + d-1], result[i]);
+      }
+    }
+    NTL_EXEC_RANGE_END
+  }
+  return result;
+}
+template<class T>
+inline SHEVector<T> inclusiveScan(const SHEVector<T> &v,
+                                  SHEScanOp op=SHEScanAdd)
+{ return inclusiveScan(v, sheScanFunction<T>(op)); }
+
+// result[0] = identity, result[i] = v[0] op ... op v[i-1]
+template<class T>
+inline SHEVector<T> exclusiveScan(const SHEVector<T> &v, const T &identity,
+                                  const SHEScanFunction<T> &op)
+{
+  SHEVector<T> head(v);
+  if (head.size() == 0) {
+    return head;
+  }
+  head.resize(head.size()-1);
+  SHEVector<T> result(inclusiveScan(head, op));
+  result.insert(result.begin(), identity);
+  return result;
+}
+template<class T>
+inline SHEVector<T> exclusiveScan(const SHEVector<T> &v, const T &identity,
+                                  SHEScanOp op=SHEScanAdd)
+{ return exclusiveScan(v, identity, sheScanFunction<T>(op)); }
+
+//
+// count_if(), sum_if(), any_of() and all_of() reduce a vector of encrypted
+// predicates (SHEBool, or any SHEInt where non-zero is true) in a single
+// circuit rather than a loop of selects and full width adds. See
+// countTrue() and friends in SHEInt.h. sum_if() on SHEFp and SHEFixed
+// selects each value against zero and sums in a tree.
+//
+template<class B>
+inline SHEInt count_if(const std::vector<B> &pred)
+{ return countTrue(std::vector<SHEInt>(pred.begin(), pred.end())); }
+template<class B>
+inline SHEBool any_of(const std::vector<B> &pred)
+{ return SHEBool(anyTrue(std::vector<SHEInt>(pred.begin(), pred.end()))); }
+template<class B>
+inline SHEBool all_of(const std::vector<B> &pred)
+{ return SHEBool(allTrue(std::vector<SHEInt>(pred.begin(), pred.end()))); }
+
+template<class T, class B>
+inline T sum_if(const SHEVector<T> &v, const std::vector<B> &pred)
+{
+  helib::assertTrue((v.size() == pred.size()) && (v.size() > 0),
+                    "sum_if needs values and predicates of one size");
+  T result(v[0]);
+  if constexpr (std::is_base_of<SHEInt, T>::value) {
+    result = sumIf(std::vector<SHEInt>(v.begin(), v.end()),
+                   std::vector<SHEInt>(pred.begin(), pred.end()));
+  } else {
+    std::vector<T> terms;
+    for (int i=0; i < v.size(); i++) {
+      terms.push_back(select(pred[i], v[i], T(v[i], 0.0)));
+    }
+    result = sheTreeSum(terms);
+  }
+  return result;
+}
+
+//
+// histogram() counts the values falling in each of the buckets set by the
+// sorted plaintext boundaries b[0] < b[1] < ... < b[k-2]:
+//   bucket 0 is x < b[0], bucket i is b[i-1] <= x < b[i], and bucket k-1
+//   is x >= b[k-2].
+// Each value is compared once against each boundary. Since x >= b[i]
+// implies x >= b[i-1], the one hot bucket bits are the XOR of adjacent
+// compares, which needs no more compares or ANDs. Each bucket's bits are
+// then counted in one carry save tree (see countTrue() in SHEInt.h).
+//
+template<class T, class P>
+inline std::vector<SHEInt> histogram(const SHEVector<T> &v,
+                                     const std::vector<P> &boundaries)
+{
+  helib::assertTrue(v.size() > 0, "histogram of an empty vector");
+  helib::assertTrue(boundaries.size() > 0, "histogram needs a boundary");
+  for (int j=1; j < boundaries.size(); j++) {
+    helib::assertTrue(boundaries[j-1] < boundaries[j],
+                      "histogram boundaries must be sorted");
+  }
+  int k = boundaries.size()+1;
+  SHEVector<T> values(v);
+  values.verifyArgs();
+  std::vector<std::vector<SHEInt>> bucket(k);
+  for (int i=0; i < values.size(); i++) {
+    SHEInt below(values[i] < T(values[i], boundaries[0]));
+    bucket[0].push_back(below);
+    SHEInt previous(!below);
+    for (int j=1; j < boundaries.size(); j++) {
+      SHEInt atLeast(!(values[i] < T(values[i], boundaries[j])));
+      bucket[j].push_back(previous ^ atLeast);
+      previous = atLeast;
+    }
+    bucket[k-1].push_back(previous);
+  }
+  std::vector<SHEInt> count;
+  for (auto &bits : bucket) {
+    count.push_back(countTrue(bits));
+  }
+  return count;
+}
+
+#endif
@@ -18,18 +18,25 @@
 #define SHECONTEXT_MAX_GEN_SIZE 3
 #define SHECONTEXT_MAX_ORD_SIZE 3
 // SHEMATH_TRIG  number of tailor series for trig functions
-// can't be > 36! or you need to update the taylor_tan array
 #define SHEMATH_TRIG_LOOP_COUNT 15
-// arc function loops (inverse trig)
-#define SHEMATH_ARC_LOOP_COUNT 5
-// number of tailor series for Natural log calculations
-#define SHEMATH_LN_LOOP_COUNT 5
-// number of Simpson interations to calculate an integral (must be odd)
-#define SHEMATH_INTEGRAL_LOOP_COUNT 25
+// number of index bits for the range reduction tables in sin, cos, tan
+// and exp (2^n entries per table)
+#define SHEMATH_TABLE_BITS 4
+// degree of the piecewise chebyshev fits for erf, gamma and the bessel
+// functions (trimmed to the mantissa size at run time)
+#define SHEMATH_APPROX_DEGREE 16
 // number of Newton's steps to take
 #define SHEMATH_NEWTON_LOOP_COUNT 3
-// number of steps to take for the bessel functions
-#define SHEMATH_BESSEL_LOOP_COUNT 3
+// jn and yn handle orders up to 2^n-1
+#define SHEMATH_BESSEL_ORDER_BITS 4
+// largest SHEInt we will decode into one hot bits (2^n outputs)
+#define SHEINT_MAX_DECODE_BITS 16
+// floats with mantissas this size or smaller normalize with a table of
+// plaintext shifts rather than counting bits and doing an encrypted shift
+#define SHEFP_TABLE_NORMALIZE_MAX 8
+// floats with mantissas this size or smaller multiply with a lookup
+// table rather than the binary multiplier
+#define SHEFP_LUT_MULTIPLY_MAX 4
 
 //////////////////////////////////////////////////////////////
 // flags
@@ -82,6 +89,8 @@
 #else
 #define F_epsilon (1.5e-7)
 #endif
+// how far the fixed point tests (SHEFixed32) can be from the double result
+#define X_epsilon (.001)
 
 
 #endif
@@ -14,6 +14,7 @@ SHEContextHash SHEContext::binaryDatabase;// = {0};
 SHEContextHash SHEContext::bgvDatabase;// = {0};
 SHEContextHash SHEContext::cvvDatabase;// = {0};
 std::ostream *SHEContext::log = nullptr;
+std::mutex SHEContext::databaseLock;
 
 static const struct {
   SHEContextType type;
@@ -715,6 +716,7 @@ SHEContext::FreeContext(SHEContextType type, long securityLevel, long capacity)
 {
   SHEContextHash *hash = SHEContext::GetContextHash(type);
   helib::Context *context;
+  std::lock_guard<std::mutex> guard(databaseLock);
 
   long index=makeIndex(type, securityLevel, capacity);
   context = (*hash)[index];
@@ -734,6 +736,8 @@ SHEContext::GetContext(SHEContextType type, long &securityLevel, long &capacity)
     helib::assertTrue(false,"Unknown ContextType");
     return nullptr;
   }
+  // held while a new context is built, so it's only built once
+  std::lock_guard<std::mutex> guard(databaseLock);
   long index = makeIndex(type, securityLevel, capacity);
   context = (*hash)[index];
   if (context != nullptr) {
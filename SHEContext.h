@@ -7,6 +7,7 @@
 //
 #ifndef SHEContext_H
 #define SHEContext_H 1
+#include <mutex>
 #include <unordered_map>
 #include <helib/helib.h>
 #include "SHEConfig.h"
@@ -30,6 +31,8 @@ class SHEContext
 {
 private:
   static std::ostream *log;
+  // contexts are shared by every thread, lookups hold the lock
+  static std::mutex databaseLock;
   static  SHEContextHash binaryDatabase;
   static  SHEContextHash bgvDatabase;
   static  SHEContextHash cvvDatabase;
@@ -0,0 +1,301 @@
+//
+// encrypted control flow: conditional blocks and bounded loops
+//
+#ifndef SHEControl_H_
+#define SHEControl_H_ 1
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <map>
+#include <type_traits>
+#include <vector>
+#include "SHEInt.h"
+#include "SHEConfig.h"
+
+//
+// An encrypted condition can't pick which code runs, so every variable
+// assigned under it needs a select. SHEIf collects the assignments of a
+// block and applies them together:
+//
+//   SHEIf(a > b, [&](SHEIf &when) {
+//     when.assign(a, a - b);
+//     when.assign(count, count + 1);
+//   }, [&](SHEIf &when) {
+//     when.assign(b, b - a);
+//   });
+//
+// is a = (a > b) ? a - b : a; count = (a > b) ? count + 1 : count; and
+// b = (a > b) ? b : b - a. The block can also be built by hand:
+//
+//   SHEIf when(a > b);
+//   when.assign(a, a - b);
+//   when.otherwise();
+//   when.assign(b, b - a);
+//   when.commit();
+//
+// Assignments are deferred until commit() (the end of the lambda form), so
+// reads inside the block see the values from before the block, as if every
+// right hand side was evaluated first. Assigning the same variable twice on
+// one side keeps the last value.
+//
+// On commit the condition and every SHEInt value is brought up to capacity
+// in one packed recrypt, the condition is widened into a mask once for each
+// target width, and each target costs one AND per bit
+//
+//   target = ifFalse ^ (mask & (ifTrue ^ ifFalse))
+//
+// rather than a select with its own recrypt check. Targets that aren't
+// SHEInts (SHEFp, SHEString, ...) fall back to select(cond, a, b).
+// Nested blocks should AND their conditions: SHEIf(outer && inner, ...).
+//
+class SHEIf {
+private:
+  struct SHEIfEntry {
+    SHEInt *target;
+    SHEInt ifTrue;
+    SHEInt ifFalse;
+  };
+  SHEInt cond;
+  bool elseSide;
+  std::vector<SHEIfEntry> entries;
+  std::vector<std::function<void(const SHEInt &)>> others;
+
+  SHEIfEntry &entry(SHEInt &target)
+  {
+    for (auto &e : entries) {
+      if (e.target == &target) {
+        return e;
+      }
+    }
+    entries.push_back({&target, target, target});
+    return entries.back();
+  }
+  void assignInt(SHEInt &target, const SHEInt &value)
+  {
+    SHEIfEntry &e = entry(target);
+    if (elseSide) {
+      e.ifFalse = value;
+    } else {
+      e.ifTrue = value;
+    }
+  }
+
+public:
+  SHEIf(const SHEInt &cond_) :
+        cond(cond_.getSize() == 1 ? cond_ : cond_.isNotZero()),
+        elseSide(false) {}
+  template<class F>
+  SHEIf(const SHEInt &cond_, F thenBody) : SHEIf(cond_)
+  {
+    thenBody(*this);
+    commit();
+  }
+  template<class F, class G>
+  SHEIf(const SHEInt &cond_, F thenBody, G elseBody) : SHEIf(cond_)
+  {
+    thenBody(*this);
+    otherwise();
+    elseBody(*this);
+    commit();
+  }
+  SHEIf(const SHEIf &) = delete;
+  SHEIf &operator=(const SHEIf &) = delete;
+
+  const SHEInt &getCondition(void) const { return cond; }
+  bool isElse(void) const { return elseSide; }
+  // following assignments happen when the condition is false
+  void otherwise(void) { elseSide = true; }
+
+  // target = value, if we are on the taken side
+  template<class T, class V>
+  void assign(T &target, const V &value)
+  {
+    if constexpr (std::is_base_of<SHEInt, T>::value) {
+      if constexpr (std::is_arithmetic<V>::value) {
+        assignInt(target, SHEInt(target, (uint64_t)value));
+      } else {
+        assignInt(target, value);
+      }
+    } else {
+      T newValue(value);
+      if (elseSide) {
+        others.push_back([&target, newValue](const SHEInt &c)
+                         { target = select(c, target, newValue); });
+      } else {
+        others.push_back([&target, newValue](const SHEInt &c)
+                         { target = select(c, newValue, target); });
+      }
+    }
+  }
+  // target = cond ? ifTrue : ifFalse
+  template<class T, class V, class W>
+  void assign(T &target, const V &ifTrue, const W &ifFalse)
+  {
+    bool side = elseSide;
+    elseSide = false;
+    assign(target, ifTrue);
+    elseSide = true;
+    assign(target, ifFalse);
+    elseSide = side;
+  }
+
+  // apply the pending assignments
+  void commit(void)
+  {
+    if (entries.size()) {
+      std::vector<SHEInt *> values = { &cond };
+      for (auto &e : entries) {
+        values.push_back(&e.ifTrue);
+        values.push_back(&e.ifFalse);
+      }
+      SHEInt::verifyArgs(values);
+      std::map<int, SHEInt> masks;
+      for (auto &e : entries) {
+        int size = e.target->getSize();
+        bool isUnsigned = e.target->getUnsigned();
+        auto mask = masks.find(size);
+        if (mask == masks.end()) {
+          SHEInt m(cond);
+          m.reset(size, false);   // sign extend the condition bit
+          mask = masks.insert({size, m}).first;
+        }
+        e.ifTrue.reset(size, isUnsigned);
+        e.ifFalse.reset(size, isUnsigned);
+        SHEInt result(e.ifFalse ^ (mask->second & (e.ifTrue ^ e.ifFalse)));
+        result.reset(size, isUnsigned);
+        *e.target = result;
+      }
+    }
+    for (auto &other : others) {
+      other(cond);
+    }
+    entries.clear();
+    others.clear();
+  }
+};
+
+//
+// An encrypted condition can't end a loop, so a while loop runs for a
+// plaintext bound of iterations and stops updating its variables once the
+// condition goes false. SHELoop runs
+//
+//   while (a < b) {
+//     a += 1;
+//     b >>= 1;
+//   }
+//
+// as
+//
+//   SHELoop loop(a.getSize(), { &a, &b });
+//   loop.run([&]() { return a < b; },
+//            [&](SHEIf &when) {
+//              when.assign(a, a + 1);
+//              when.assign(b, b >> 1);
+//            });
+//
+// Each iteration the body is an SHEIf on (not done && condition), so only
+// the variables the body assigns are selected; the rest are left alone.
+// getDone() is true if the condition went false within the bound, if it
+// isn't, the bound was too small. repeat() runs a fixed number of
+// iterations with no condition and no selects at all.
+//
+// The carried variables (and the done flag) are the loop's state. Before
+// each iteration they are brought up to capacity together in one packed
+// recrypt if any of them couldn't survive another iteration, using the
+// largest capacity an iteration has used so far. So the body rarely runs
+// out of capacity in the middle and bootstraps a value on its own.
+// setRecryptInterval(n) instead recrypts the state every n iterations.
+//
+class SHELoop {
+private:
+  int bound;
+  std::vector<SHEInt *> carried;
+  SHEInt done;
+  int recryptInterval;
+  long iterationCost;
+
+  std::vector<SHEInt *> state(void)
+  {
+    std::vector<SHEInt *> values(carried);
+    values.push_back(&done);
+    return values;
+  }
+  static long minCapacity(const std::vector<SHEInt *> &values)
+  {
+    long capacity = LONG_MAX;
+    for (auto value : values) {
+      capacity = std::min(capacity, value->bitCapacity());
+    }
+    return capacity;
+  }
+  // bring the state up to capacity, returns the capacity after
+  long prepare(int iteration)
+  {
+    std::vector<SHEInt *> values(state());
+    if (recryptInterval) {
+      if (iteration && ((iteration % recryptInterval) == 0)) {
+        SHEInt::reCrypt(values);
+      }
+    } else {
+      long level = std::min(SHEINT_DEFAULT_LEVEL_TRIGGER + iterationCost,
+                            (long)SHEINT_LEVEL_THRESHOLD);
+      SHEInt::verifyArgs(values, level);
+    }
+    return minCapacity(values);
+  }
+  void measure(long before)
+  {
+    long after = minCapacity(state());
+    if ((before != LONG_MAX) && (after != LONG_MAX) && (before > after)) {
+      iterationCost = std::max(iterationCost, before - after);
+    }
+  }
+
+public:
+  SHELoop(int bound_, const std::vector<SHEInt *> &carried_) :
+          bound(bound_), carried(carried_), done(*carried_.at(0)),
+          recryptInterval(0), iterationCost(0)
+  {
+    helib::assertTrue(bound >= 0, "negative loop bound");
+    done = SHEInt(done.getPublicKey(), (uint64_t)0, 1, true);
+  }
+  SHELoop(const SHELoop &) = delete;
+  SHELoop &operator=(const SHELoop &) = delete;
+
+  // accessor functions
+  int getBound(void) const { return bound; }
+  const SHEInt &getDone(void) const { return done; }
+  long getIterationCost(void) const { return iterationCost; }
+  // 0 recrypts when needed (the default)
+  void setRecryptInterval(int interval) { recryptInterval = interval; }
+
+  // while (cond()) body(when); for at most bound iterations
+  template<class C, class B>
+  void run(C cond, B body)
+  {
+    for (int i=0; i < bound; i++) {
+      long before = prepare(i);
+      SHEInt active(!done && cond());
+      done = !active;
+      SHEIf when(active);
+      body(when);
+      when.commit();
+      measure(before);
+    }
+  }
+  // body(i) for i in [0, bound), the body assigns the carried variables
+  // directly
+  template<class B>
+  void repeat(B body)
+  {
+    for (int i=0; i < bound; i++) {
+      long before = prepare(i);
+      body(i);
+      measure(before);
+    }
+  }
+};
+
+#endif
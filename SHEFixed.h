@@ -0,0 +1,522 @@
+//
+// encrypted fixed point numbers
+//
+#ifndef SHEFixed_H_
+#define SHEFixed_H_ 1
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+#include <helib/helib.h>
+#include "SHEInt.h"
+#include "SHEFp.h"
+#include "SHEUtil.h"
+#include "SHEMagic.h"
+#include "helibio.h"
+
+//
+// SHEFixed stores a two's complement value scaled by 2^fracBits in a single
+// SHEInt of intBits+fracBits bits (intBits includes the sign bit). There is
+// no exponent to align and no mantissa to normalize, so add and subtract are
+// plain integer operations and multiply is one integer multiply plus a free
+// shift. The cost is a fixed range and precision.
+//
+// Add and subtract wrap like the underlying SHEInt. Multiply, divide,
+// constant scaling and conversions saturate to the largest or smallest
+// representable value. Multiply and divide round toward -infinity. NaNs
+// convert to zero.
+//
+template<int intBits, int fracBits>
+class SHEFixed
+{
+private:
+  template<int, int> friend class SHEFixed;
+  SHEInt value;
+
+  // sign or zero extend to a signed int of at least size bits
+  static SHEInt widen(const SHEInt &a, int size)
+  {
+    SHEInt wide(a);
+    if (a.getUnsigned()) {
+      wide.reset(a.getSize()+1, true);
+    }
+    wide.reset(std::max(size, wide.getSize()), false);
+    return wide;
+  }
+  // truncate a wide signed result to our size, clamping values that don't
+  // fit. Everything from our sign bit up must match, so we only need a
+  // couple of zero checks rather than full compares.
+  static SHEInt saturate(const SHEInt &wide)
+  {
+    SHEInt result(wide);
+    result.reset(totalBits, false);
+    if (wide.getSize() <= totalBits) {
+      return result;
+    }
+    SHEInt top(wide >> (totalBits-1));
+    SHEInt neg(wide.isNegative());
+    SHEInt maxv(result, (uint64_t)maxRaw);
+    SHEInt minv(result, (uint64_t)minRaw);
+    result = (top.isNotZero() && !neg).select(maxv, result);
+    result = ((~top).isNotZero() && neg).select(minv, result);
+    return result;
+  }
+  // multiply by a plaintext constant with shifts and adds. The constant is
+  // recoded in non-adjacent form, so a run of ones costs one add and one
+  // subtract rather than one add per bit.
+  static SHEInt mulConstant(const SHEInt &x, uint64_t c)
+  {
+    SHEInt result(x);
+    bool first = true;
+    for (int shift=0; c; shift++, c >>= 1) {
+      if ((c & 1) == 0) {
+        continue;
+      }
+      bool subtract = ((c & 3) == 3) && (c != 3);
+      SHEInt term(x << shift);
+      if (first) {
+        result = subtract ? -term : term;
+        first = false;
+      } else if (subtract) {
+        result -= term;
+      } else {
+        result += term;
+      }
+      if (subtract) {
+        c += 1;
+      } else {
+        c -= 1;
+      }
+    }
+    if (first) {
+      result = SHEInt(x, (uint64_t)0);
+    }
+    return result;
+  }
+  // raw * a. a is split into an odd integer and a power of two so powers
+  // of two are just a shift, and everything else costs one add or subtract
+  // per non-zero digit of the constant.
+  static SHEInt scale(const SHEInt &raw, shemaxfloat_t a)
+  {
+    if (std::isnan(a) || (a == 0.0)) {
+      return SHEInt(raw, (uint64_t)0);
+    }
+    bool negate = std::signbit(a);
+    a = shemaxfloat_abs(a);
+    int e;
+    if (!std::isinf(a)) {
+      shemaxfloat_frexp(a, &e);
+    }
+    if (std::isinf(a) || (e > totalBits)) {
+      // any non-zero value overflows
+      SHEInt maxv(raw, (uint64_t)maxRaw);
+      SHEInt minv(raw, (uint64_t)minRaw);
+      SHEInt result(raw.isNegative().select(negate ? maxv : minv,
+                                            negate ? minv : maxv));
+      return select(raw.isZero(), (uint64_t)0, result);
+    }
+    // a = c * 2^shift where c is odd
+    const int precision = std::min(totalBits, 62);
+    int shift = e - precision;
+    uint64_t c = (uint64_t)std::llround(std::ldexp(a, -shift));
+    while (c && ((c & 1) == 0)) {
+      c >>= 1;
+      shift++;
+    }
+    int width = totalBits + SHEInt::getBitSize(c) + std::max(shift, 0) + 1;
+    SHEInt wide(raw);
+    wide.reset(width, false);
+    if (c != 1) {
+      wide = mulConstant(wide, c);
+    }
+    if (negate) {
+      wide = -wide;
+    }
+    if (shift > 0) {
+      wide <<= shift;
+    } else if (shift < 0) {
+      wide >>= std::min(-shift, width-1);
+    }
+    return saturate(wide);
+  }
+  static SHEInt fromSHEFp(const SHEFp &a)
+  {
+    const SHEInt &mantissa = a.getMantissa();
+    int mantissaSize = mantissa.getSize();
+    // a = mantissa * 2^(unbiasedExp-mantissaSize), so our raw value is the
+    // mantissa shifted by unbiasedExp-mantissaSize+fracBits.
+    SHEInt shift(a.getUnbiasedExp());
+    shift.reset(std::max(shift.getSize(),
+                (int)SHEInt::getBitSize(mantissaSize+fracBits+totalBits))+1,
+                false);
+    int64_t adjust = (int64_t)fracBits - mantissaSize;
+    if (adjust > 0) {
+      shift += (uint64_t)adjust;
+    } else if (adjust < 0) {
+      shift -= (uint64_t)-adjust;
+    }
+    SHEInt raw(mantissa);
+    raw.reset(std::max(mantissaSize, totalBits)+1, true);
+    raw = raw.leftShiftSigned(shift);
+    raw.reset(totalBits, true);
+    raw.reset(totalBits, false);
+    raw = a.getSign().select(-raw, raw);
+    SHEInt maxv(raw, (uint64_t)maxRaw);
+    SHEInt minv(raw, (uint64_t)minRaw);
+    SHEBool over(a.abs() >= std::ldexp((shemaxfloat_t)1.0, intBits-1));
+    raw = over.select(a.getSign().select(minv, maxv), raw);
+    return select(a.isNan(), (uint64_t)0, raw);
+  }
+
+public:
+  static_assert(intBits > 0, "SHEFixed needs at least a sign bit");
+  static_assert(fracBits >= 0, "SHEFixed fraction bits can't be negative");
+  static_assert(intBits+fracBits <= 64, "SHEFixed is limited to 64 bits");
+  static constexpr std::string_view typeName = "SHEFixed";
+  static constexpr int integerBits = intBits;
+  static constexpr int fractionBits = fracBits;
+  static constexpr int totalBits = intBits + fracBits;
+  static constexpr int64_t maxRaw = (int64_t)((1ULL << (totalBits-1)) - 1);
+  static constexpr int64_t minRaw = -maxRaw - 1;
+
+  // plaintext conversions to and from the scaled integer
+  static int64_t toRaw(shemaxfloat_t a)
+  {
+    if (std::isnan(a)) {
+      return 0;
+    }
+    shemaxfloat_t scaled = std::round(std::ldexp(a, fracBits));
+    if (scaled >= (shemaxfloat_t)maxRaw) {
+      return maxRaw;
+    }
+    if (scaled <= (shemaxfloat_t)minRaw) {
+      return minRaw;
+    }
+    return (int64_t)scaled;
+  }
+  static shemaxfloat_t fromRaw(int64_t raw)
+  { return std::ldexp((shemaxfloat_t)raw, -fracBits); }
+  static shemaxfloat_t getMax(void) { return fromRaw(maxRaw); }
+  static shemaxfloat_t getMin(void) { return fromRaw(1); }
+
+  explicit SHEFixed(const SHEPublicKey &pubKey, const char *label=nullptr) :
+    value(pubKey, (uint64_t)0, totalBits, false, label) {}
+  SHEFixed(const SHEPublicKey &pubKey, shemaxfloat_t a,
+           const char *label=nullptr) :
+    value(pubKey, (uint64_t)toRaw(a), totalBits, false, label) {}
+  // create a SHEFixed using the context of a model SHEFixed
+  SHEFixed(const SHEFixed &model, shemaxfloat_t a,
+           const char *label=nullptr) :
+    value(model.value, (uint64_t)toRaw(a), label) {}
+  SHEFixed(const SHEFixed &a, const char *label) : value(a.value, label) {}
+  SHEFixed(const SHEFixed &a) : value(a.value) {}
+  // conversions, all of them saturate
+  explicit SHEFixed(const SHEInt &a, const char *label=nullptr) :
+    value(a, label)
+  {
+    SHEInt wide(widen(a, a.getSize()+fracBits+1));
+    wide <<= fracBits;
+    value = saturate(wide);
+  }
+  template<int intBits2, int fracBits2>
+  explicit SHEFixed(const SHEFixed<intBits2, fracBits2> &a,
+                    const char *label=nullptr) : value(a.value, label)
+  {
+    SHEInt wide(widen(a.value, std::max(intBits, intBits2) +
+                               std::max(fracBits, fracBits2)+1));
+    if (fracBits > fracBits2) {
+      wide <<= fracBits - fracBits2;
+    } else if (fracBits < fracBits2) {
+      wide >>= fracBits2 - fracBits;
+    }
+    value = saturate(wide);
+  }
+  explicit SHEFixed(const SHEFp &a, const char *label=nullptr) :
+    value(a.getSign(), label) { value = fromSHEFp(a); }
+  SHEFixed &operator=(const SHEFixed &a) { value = a.value; return *this; }
+  SHEFixed &operator=(shemaxfloat_t a)
+  { value = SHEInt(value, (uint64_t)toRaw(a)); return *this; }
+
+  // exact conversion of the raw integer, then scale by 2^-fracBits
+  SHEFp toSHEFp(void) const
+  {
+    SHEFp result(value);
+    result.setUnbiasedExp(result.getUnbiasedExp() - (uint64_t)fracBits);
+    return select(value.isZero(), (shemaxfloat_t)0.0, result);
+  }
+  // convert to the sizes of model. If the model can't hold our whole range
+  // we saturate to its max and flush anything below its min to zero.
+  SHEFp toSHEFp(const SHEFp &model) const
+  {
+    SHEFp result(toSHEFp());
+    result.reset(model.getExp().getSize(), model.getMantissa().getSize());
+    shemaxfloat_t max = model.getMax();
+    shemaxfloat_t min = model.getMin();
+    if (max < getMax()) {
+      int64_t limit = toRaw(max);
+      SHEBool over((value > limit) || (value < -limit));
+      SHEFp maxFp(model, max);
+      maxFp.setSign(value.isNegative());
+      result = select(over, maxFp, result);
+    }
+    if (min > getMin()) {
+      int64_t limit = toRaw(min);
+      SHEBool under((value < limit) && (value > -limit));
+      result = select(under, (shemaxfloat_t)0.0, result);
+    }
+    return result;
+  }
+
+  // arithmetic operators
+  SHEFixed operator-(void) const
+  { SHEFixed result(*this); result.value = -value; return result; }
+  SHEFixed abs(void) const
+  { SHEFixed result(*this); result.value = value.abs(); return result; }
+  SHEFixed operator+(const SHEFixed &a) const
+  { SHEFixed result(*this); result.value += a.value; return result; }
+  SHEFixed operator-(const SHEFixed &a) const
+  { SHEFixed result(*this); result.value -= a.value; return result; }
+  SHEFixed operator*(const SHEFixed &a) const
+  {
+    SHEFixed result(*this);
+    SHEInt wide(value);
+    SHEInt wideA(a.value);
+    wide.reset(2*totalBits, false);
+    wideA.reset(2*totalBits, false);
+    wide *= wideA;
+    wide >>= fracBits;
+    result.value = saturate(wide);
+    return result;
+  }
+  SHEFixed operator/(const SHEFixed &a) const
+  {
+    SHEFixed result(*this);
+    SHEInt num(value);
+    num.reset(totalBits+fracBits+1, false);
+    num <<= fracBits;
+    SHEInt den(a.value);
+    den.reset(num.getSize(), false);
+    result.value = saturate(num / den);
+    return result;
+  }
+  SHEFixed operator+(shemaxfloat_t a) const
+  { SHEFixed result(*this); result.value += (uint64_t)toRaw(a);
+    return result; }
+  SHEFixed operator-(shemaxfloat_t a) const
+  { SHEFixed result(*this); result.value -= (uint64_t)toRaw(a);
+    return result; }
+  SHEFixed operator*(shemaxfloat_t a) const
+  { SHEFixed result(*this); result.value = scale(value, a); return result; }
+  SHEFixed operator/(shemaxfloat_t a) const
+  { SHEFixed result(*this); result.value = scale(value, 1.0/a);
+    return result; }
+  SHEFixed &operator+=(const SHEFixed &a) { *this = *this + a; return *this; }
+  SHEFixed &operator-=(const SHEFixed &a) { *this = *this - a; return *this; }
+  SHEFixed &operator*=(const SHEFixed &a) { *this = *this * a; return *this; }
+  SHEFixed &operator/=(const SHEFixed &a) { *this = *this / a; return *this; }
+  SHEFixed &operator+=(shemaxfloat_t a) { *this = *this + a; return *this; }
+  SHEFixed &operator-=(shemaxfloat_t a) { *this = *this - a; return *this; }
+  SHEFixed &operator*=(shemaxfloat_t a) { *this = *this * a; return *this; }
+  SHEFixed &operator/=(shemaxfloat_t a) { *this = *this / a; return *this; }
+  SHEFixed &operator++(void) { return *this += 1.0; }
+  SHEFixed &operator--(void) { return *this -= 1.0; }
+  SHEFixed operator++(int) { SHEFixed old(*this); ++(*this); return old; }
+  SHEFixed operator--(int) { SHEFixed old(*this); --(*this); return old; }
+  // logical operators
+  SHEBool operator!(void) const { return value.isZero(); }
+  SHEBool operator<(const SHEFixed &a) const { return value < a.value; }
+  SHEBool operator>(const SHEFixed &a) const { return value > a.value; }
+  SHEBool operator>=(const SHEFixed &a) const { return value >= a.value; }
+  SHEBool operator<=(const SHEFixed &a) const { return value <= a.value; }
+  SHEBool operator!=(const SHEFixed &a) const { return value != a.value; }
+  SHEBool operator==(const SHEFixed &a) const { return value == a.value; }
+  SHEBool operator<(shemaxfloat_t a) const { return value < toRaw(a); }
+  SHEBool operator>(shemaxfloat_t a) const { return value > toRaw(a); }
+  SHEBool operator>=(shemaxfloat_t a) const { return value >= toRaw(a); }
+  SHEBool operator<=(shemaxfloat_t a) const { return value <= toRaw(a); }
+  SHEBool operator!=(shemaxfloat_t a) const
+  { return value != (uint64_t)toRaw(a); }
+  SHEBool operator==(shemaxfloat_t a) const
+  { return value == (uint64_t)toRaw(a); }
+  SHEBool isZero(void) const { return value.isZero(); }
+  SHEBool isNotZero(void) const { return value.isNotZero(); }
+  SHEBool isNegative(void) const { return value.isNegative(); }
+  SHEBool isPositive(void) const { return value.isPositive(); }
+
+  friend SHEFixed select(const SHEInt &sel, const SHEFixed &a_true,
+                         const SHEFixed &a_false)
+  { SHEFixed result(a_false);
+    result.value = sel.select(a_true.value, a_false.value);
+    return result; }
+  friend SHEFixed select(const SHEInt &sel, const SHEFixed &a_true,
+                         shemaxfloat_t a_false)
+  { SHEFixed result(a_true);
+    result.value = sel.select(a_true.value, (uint64_t)toRaw(a_false));
+    return result; }
+  friend SHEFixed select(const SHEInt &sel, shemaxfloat_t a_true,
+                         const SHEFixed &a_false)
+  { SHEFixed result(a_false);
+    result.value = sel.select((uint64_t)toRaw(a_true), a_false.value);
+    return result; }
+
+  // Accessor functions
+  const SHEInt &getValue(void) const { return value; }
+  void setValue(const SHEInt &a) { value = a; value.reset(totalBits, false); }
+  // set from a scaled value of any size, saturating rather than wrapping
+  void setValueSaturate(const SHEInt &a)
+  { value = saturate(widen(a, totalBits)); }
+  const SHEPublicKey &getPublicKey(void) const
+  { return value.getPublicKey(); }
+  const char *getLabel(void) const { return value.getLabel(); }
+  void clear(void) { value.clear(); }
+  shemaxfloat_t decrypt(const SHEPrivateKey &privKey) const
+  { return fromRaw((int64_t)value.decryptRaw(privKey)); }
+
+  // bootstrapping help
+  long bitCapacity(void) const { return value.bitCapacity(); }
+  double securityLevel(void) const { return value.securityLevel(); }
+  bool isCorrect(void) const { return value.isCorrect(); }
+  bool needRecrypt(long level=SHEINT_DEFAULT_LEVEL_TRIGGER) const
+  { return value.needRecrypt(level); }
+  bool needRecrypt(const SHEFixed &a,
+                   long level=SHEINT_DEFAULT_LEVEL_TRIGGER) const
+  { return value.needRecrypt(a.value, level); }
+  void verifyArgs(long level=SHEINT_DEFAULT_LEVEL_TRIGGER)
+  { value.verifyArgs(level); }
+  void verifyArgs(SHEFixed &a, long level=SHEINT_DEFAULT_LEVEL_TRIGGER)
+  { value.verifyArgs(a.value, level); }
+  void reCrypt(bool force=false) { value.reCrypt(force); }
+  void reCrypt(SHEFixed &a, bool force=false)
+  { value.reCrypt(a.value, force); }
+  void reCrypt(SHEFixed &a, SHEFixed &b, bool force=false)
+  { value.reCrypt(a.value, b.value, force); }
+  void reCrypt(SHEFixed &a, SHEFixed &b, SHEFixed &c, bool force=false)
+  { value.reCrypt(a.value, b.value, c.value, force); }
+  void reCrypt(SHEFixed &a, SHEFixed &b, SHEFixed &c, SHEFixed &d,
+               bool force=false)
+  { value.reCrypt(a.value, b.value, c.value, d.value, force); }
+  void reCrypt(SHEFixed &a, SHEFixed &b, SHEFixed &c, SHEFixed &d,
+               SHEFixed &e, bool force=false)
+  { value.reCrypt(a.value, b.value, c.value, d.value, e.value, force); }
+
+  // input/output functions
+  void writeTo(std::ostream& str) const
+  {
+    write_raw_int(str, SHEFixedMagic); // magic to say we're a SHEFixed
+    write_raw_int(str, intBits);
+    write_raw_int(str, fracBits);
+    value.writeTo(str);
+  }
+  void writeToJSON(std::ostream& str) const
+  { helib::executeRedirectJsonError<void>([&]() { str << writeToJSON(); }); }
+  helib::JsonWrapper writeToJSON(void) const
+  {
+    auto body = [this]() {
+      json j = {{"intBits", intBits},
+                {"fracBits", fracBits},
+                {"value", helib::unwrap(this->value.writeToJSON())}};
+      return helib::wrap(helib::toTypedJson<SHEFixed>(j));
+    };
+    return helib::executeRedirectJsonError<helib::JsonWrapper>(body);
+  }
+  static SHEFixed readFrom(std::istream& str, const SHEPublicKey &pubKey)
+  {
+    SHEFixed a(pubKey);
+    a.read(str);
+    return a;
+  }
+  static SHEFixed readFromJSON(std::istream& str, const SHEPublicKey &pubKey)
+  {
+    return helib::executeRedirectJsonError<SHEFixed>([&]() {
+      json j;
+      str >> j;
+      return readFromJSON(helib::wrap(j), pubKey);
+    });
+  }
+  static SHEFixed readFromJSON(const helib::JsonWrapper& j,
+                               const SHEPublicKey &pubKey)
+  {
+    SHEFixed a(pubKey);
+    a.readFromJSON(j);
+    return a;
+  }
+  void read(std::istream& str)
+  {
+    long magic = read_raw_int(str);
+    helib::assertEq<helib::IOError>(magic, SHEFixedMagic,
+                                    "not an SHEFixed on the stream");
+    long intBits_ = read_raw_int(str);
+    long fracBits_ = read_raw_int(str);
+    helib::assertEq<helib::IOError>(intBits_, (long)intBits,
+                                    "SHEFixed integer size mismatch");
+    helib::assertEq<helib::IOError>(fracBits_, (long)fracBits,
+                                    "SHEFixed fraction size mismatch");
+    value.read(str);
+  }
+  void readFromJSON(std::istream&str)
+  {
+    return helib::executeRedirectJsonError<void>([&]() {
+      json j;
+      str >> j;
+      return readFromJSON(helib::wrap(j));
+    });
+  }
+  void readFromJSON(const helib::JsonWrapper &jw)
+  {
+    auto body = [&]() {
+      json j = helib::fromTypedJson<SHEFixed>(unwrap(jw));
+      helib::assertEq<helib::IOError>(j.at("intBits").get<long>(),
+                                      (long)intBits,
+                                      "SHEFixed integer size mismatch");
+      helib::assertEq<helib::IOError>(j.at("fracBits").get<long>(),
+                                      (long)fracBits,
+                                      "SHEFixed fraction size mismatch");
+      this->value.readFromJSON(helib::wrap(j.at("value")));
+    };
+    helib::executeRedirectJsonError<void>(body);
+  }
+  void readJSON(const helib::JsonWrapper &jw) { readFromJSON(jw); }
+};
+
+// overload float(unencrypted) [op] SHEFixed
+template<int I, int F>
+inline SHEFixed<I,F> operator+(shemaxfloat_t a, const SHEFixed<I,F> &b)
+{ return b+a; }
+template<int I, int F>
+inline SHEFixed<I,F> operator-(shemaxfloat_t a, const SHEFixed<I,F> &b)
+{ return (-b)+a; }
+template<int I, int F>
+inline SHEFixed<I,F> operator*(shemaxfloat_t a, const SHEFixed<I,F> &b)
+{ return b*a; }
+template<int I, int F>
+inline SHEFixed<I,F> operator/(shemaxfloat_t a, const SHEFixed<I,F> &b)
+{ SHEFixed<I,F> heA(b, a); return heA/b; }
+template<int I, int F>
+inline SHEBool operator>(shemaxfloat_t a, const SHEFixed<I,F> &b)
+{ return b < a; }
+template<int I, int F>
+inline SHEBool operator<(shemaxfloat_t a, const SHEFixed<I,F> &b)
+{ return b > a; }
+template<int I, int F>
+inline SHEBool operator>=(shemaxfloat_t a, const SHEFixed<I,F> &b)
+{ return b <= a; }
+template<int I, int F>
+inline SHEBool operator<=(shemaxfloat_t a, const SHEFixed<I,F> &b)
+{ return b >= a; }
+template<int I, int F>
+inline SHEBool operator!=(shemaxfloat_t a, const SHEFixed<I,F> &b)
+{ return b != a; }
+template<int I, int F>
+inline SHEBool operator==(shemaxfloat_t a, const SHEFixed<I,F> &b)
+{ return b == a; }
+// io operators
+template<int I, int F>
+inline std::ostream &operator<<(std::ostream &str, const SHEFixed<I,F> &a)
+{ a.writeToJSON(str); return str; }
+template<int I, int F>
+inline std::istream &operator>>(std::istream &str, SHEFixed<I,F> &a)
+{ a.readFromJSON(str); return str; }
+
+// common sizes, Q16.16 and Q32.32
+typedef SHEFixed<16,16> SHEFixed32;
+typedef SHEFixed<32,32> SHEFixed64;
+#endif
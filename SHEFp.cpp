@@ -17,8 +17,7 @@ SHEPrivateKey *SHEFp::debugPrivKey = nullptr;
 #endif
 
 std::ostream *SHEFp::log = nullptr;
-uint64_t SHEFp::nextTmp = 0;
-SHEFpLabelHash SHEFp::labelHash;
+std::atomic<uint64_t> SHEFp::nextTmp(0);
 
 // special Exponent codings by size
 static inline uint64_t mkSpecialExp(int size)
@@ -105,7 +104,7 @@ SHEFp::SHEFp(const SHEPublicKey &pubKey, shemaxfloat_t myFloat,
               mantissa(pubKey, i_mantissa(myFloat, mantissaSize, expSize),
                        mantissaSize, true)
 {
-  if (label) labelHash[this]=label;
+  if (label) labelPtr = label;
   // if our mantissa was too big for uint64, we need to shift the result
   // back into place
   if (mantissaSize > sizeof(uint64_t)*CHAR_BIT) {
@@ -120,7 +119,7 @@ SHEFp::SHEFp(const SHEFp &model, shemaxfloat_t myFloat,const char *label)
                           i_mantissa(myFloat, model.mantissa.getSize(),
                                      model.exp.getSize()))
 {
-  if (label) labelHash[this]=label;
+  if (label) labelPtr = label;
   // if our mantissa was too big for uint64, we need to shift the result
   // back into place
   if (model.mantissa.getSize() > sizeof(uint64_t)*CHAR_BIT) {
@@ -131,7 +130,7 @@ SHEFp::SHEFp(const SHEInt &a, const char *label)
                : sign(a.isNegative()), exp(a.getPublicKey(), 0, 1, true),
                  mantissa(a.abs())
 {
-  if (label) labelHash[this]=label;
+  if (label) labelPtr = label;
 
   // figure out how big to make exponent based on the integer size
   int expSize = log2(a.getSize()) + 3;
@@ -151,7 +150,7 @@ SHEFp::SHEFp(const SHEFp &model, const SHEInt &a, const char *label)
                : sign(a.isNegative()), exp(a.getPublicKey(), 0, 1, true),
                  mantissa(a.abs())
 {
-  if (label) labelHash[this]=label;
+  if (label) labelPtr = label;
 
   // set the proper bias for the exponent.
   int expSize = model.exp.getSize();
@@ -238,7 +237,7 @@ SHEFp::SHEFp(const SHEPublicKey &pubKey, const unsigned char *encryptedInt,
              int size, const char *label) : sign(pubKey,0,1,true),
              exp(pubKey, 0, 1, true), mantissa(pubKey, 0, 1, true)
 {
-  if (label) labelHash[this]=label;
+  if (label) labelPtr = label;
   std::string s((const char *)encryptedInt, size);
   std::stringstream ss(s);
   read(ss);
@@ -248,7 +247,7 @@ SHEFp::SHEFp(const SHEPublicKey &pubKey, std::istream& str,
              const char *label) : sign(pubKey,0,1,true),
              exp(pubKey, 0, 1, true), mantissa(pubKey, 0, 1, true)
 {
-  if (label) labelHash[this]=label;
+  if (label) labelPtr = label;
   readFromJSON(str);
 }
 
@@ -335,6 +334,10 @@ void SHEFp::verifyArgs(long level)
 
 void SHEFp::normalize(void)
 {
+  if (mantissa.getSize() <= SHEFP_TABLE_NORMALIZE_MAX) {
+    normalizeSmall();
+    return;
+  }
   // this is an expensive capacity call, make sure our inputs are good
   mantissa.verifyArgs(exp, 2*SHEINT_DEFAULT_LEVEL_TRIGGER);
   SHEInt shift(exp, (uint64_t)0);
@@ -364,6 +367,46 @@ void SHEFp::normalize(void)
   exp = saveSpecial.select(mkSpecialExp(exp.getSize()),exp);
 }
 
+// For tiny mantissas we skip the bit count and the encrypted shift. Each
+// possible shift amount is a row of a table with the plaintext shifted
+// mantissa (a free rewire of the bits) and the shift constant. Exactly one
+// row is selected, so we can just xor the masked rows together.
+void SHEFp::normalizeSmall(void)
+{
+  int size = mantissa.getSize();
+  int expSize = exp.getSize();
+  mantissa.verifyArgs(exp, SHEINT_DEFAULT_LEVEL_TRIGGER);
+  SHEBool saveSpecial = isSpecial();
+  SHEInt newMantissa(mantissa, (uint64_t)0);
+  SHEInt shift(exp, (uint64_t)0);
+  SHEInt seen(mantissa.getPublicKey(), 0, 1, true);
+
+  for (int i=0; i < size; i++) {
+    SHEInt bit = mantissa.getBitHigh(i);
+    SHEInt row(bit);
+    // the leading one is bit i, and we have enough exponent to shift it up
+    if (i != 0) {
+      row = bit && !seen && (exp >= (uint64_t)i);
+      seen = seen | bit;
+    } else {
+      seen = bit;
+    }
+    // the leading one is lower, but the exponent runs out at i (denormal)
+    row ^= !seen && (exp == (uint64_t)i);
+    SHEInt mask(row);
+    mask.reset(size, false);
+    newMantissa ^= mask & (mantissa << i);
+    if (i != 0) {
+      mask.reset(expSize, false);
+      shift ^= mask & (uint64_t)i;
+    }
+  }
+  mantissa = newMantissa;
+  exp -= shift;
+  exp = mantissa.isZero().select(0,exp);
+  exp = saveSpecial.select(mkSpecialExp(expSize),exp);
+}
+
 void SHEFp::denormalize(const SHEInt &targetExp)
 {
   SHEInt shift(targetExp);
@@ -626,16 +669,6 @@ SHEFp SHEFp::operator+(const SHEFp &a) const {
   int aMantissaSize = a.mantissa.getSize();
   int thisExpSize = exp.getSize();
   int aExpSize = a.exp.getSize();
-  int maxMantissaSize = thisMantissaSize;
-  int maxExpSize = thisExpSize;
-  SHEFpBool swap(SHEBool(exp, false));
-  SHEFp big(*this, 0.0, "big");
-  SHEFp little(a, 0.0, "little");
-
-  if (log) {
-    (*log) << (SHEFpSummary) *this << ".operator+("
-           << (SHEFpSummary) a << ") = " << std::flush;
-  }
 
   // if the mantissa or exponent sizes mismatch,
   // reset to the same size before adding.
@@ -645,22 +678,29 @@ SHEFp SHEFp::operator+(const SHEFp &a) const {
       (thisExpSize != aExpSize)) {
     SHEFp tThis(*this);
     SHEFp ta(a);
-    maxMantissaSize = std::max(thisMantissaSize, aMantissaSize);
-    maxExpSize = std::max(thisExpSize, aExpSize);
+    int maxMantissaSize = std::max(thisMantissaSize, aMantissaSize);
+    int maxExpSize = std::max(thisExpSize, aExpSize);
     tThis.reset(maxExpSize, maxMantissaSize);
     ta.reset(maxExpSize, maxMantissaSize);
-    swap=tThis.exp < ta.exp;
-    big = swap.select(ta, tThis);
-    little = swap.select(tThis, ta);
-  } else {
-    // already the same size, dispense with the expensive
-    // reset.
-    swap=exp < a.exp;
-    big = swap.select(a, *this);
-    little = swap.select(*this, a);
+    return tThis.addSameSize(ta);
   }
+  // already the same size, dispense with the expensive
+  // reset.
+  return addSameSize(a);
+}
 
+// caller must ensure that the exponent and mantissa sizes of this and a
+// are equal. SHEFpT calls this directly for same type operands.
+SHEFp SHEFp::addSameSize(const SHEFp &a) const {
+  SHEFpBool swap(exp < a.exp);
+
+  if (log) {
+    (*log) << (SHEFpSummary) *this << ".operator+("
+           << (SHEFpSummary) a << ") = " << std::flush;
+  }
 
+  SHEFp big = swap.select(a, *this);
+  SHEFp little = swap.select(*this, a);
   big.verifyArgs(little);
   // add 1 bit for sign, 1 bit for overflow
   int mantissaSize = big.mantissa.getSize() + 2;
@@ -752,6 +792,32 @@ SHEFp &SHEFp::operator-=(shemaxfloat_t a)
   return *this = (*this) - aEncrypt;
 }
 
+// multiply tiny mantissas with a product table rather than the binary
+// multiplier. Both mantissas are decoded into one hot bits, so exactly one
+// product term is set. Each output bit is then just the xor (no multiply
+// depth) of the terms whose table entry has that bit set.
+static SHEInt lutMultiply(const SHEInt &a, const SHEInt &b)
+{
+  int size = a.getSize() + b.getSize();
+  std::vector<SHEInt> aHot = a.decode();
+  std::vector<SHEInt> bHot = b.decode();
+  SHEInt result(a.getPublicKey(), 0, size, true);
+
+  // a or b of zero produce a zero product, skip those rows
+  for (uint64_t i=1; i < aHot.size(); i++) {
+    for (uint64_t j=1; j < bHot.size(); j++) {
+      SHEInt term = aHot[i] && bHot[j];
+      uint64_t product = i*j;
+      for (int k=0; k < size; k++) {
+        if (product & (1ULL << k)) {
+          result.setBit(k, result.getBit(k) ^ term);
+        }
+      }
+    }
+  }
+  return result;
+}
+
 SHEFp SHEFp::operator*(const SHEFp &a) const
 {
 
@@ -788,8 +854,13 @@ SHEFp SHEFp::operator*(const SHEFp &a) const
   underflowAmount = -underflowAmount;
 
   // handle the mantissa
-  rmantissa.reset(result.mantissa.getSize()+a.mantissa.getSize(), true);
-  rmantissa *= a.mantissa; // do the multiply
+  if ((result.mantissa.getSize() <= SHEFP_LUT_MULTIPLY_MAX) &&
+      (a.mantissa.getSize() <= SHEFP_LUT_MULTIPLY_MAX)) {
+    rmantissa = lutMultiply(result.mantissa, a.mantissa);
+  } else {
+    rmantissa.reset(result.mantissa.getSize()+a.mantissa.getSize(), true);
+    rmantissa *= a.mantissa; // do the multiply
+  }
   rmantissa >>= a.mantissa.getSize(); // shift back to original location
   rmantissa.reset(result.mantissa.getSize(), true);
   // overflow and underflow processing
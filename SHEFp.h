@@ -35,26 +35,29 @@ typedef long double shemaxfloat_t;
 
 
 class SHEFp;
-typedef std::unordered_map<const SHEFp *,const char *>SHEFpLabelHash;
+
+template<int expSize, int mantissaSize, typename nativeType> class SHEFpT;
 
 class SHEFp {
 private:
   friend class SHEFpSummary;
+  template<int expSize, int mantissaSize, typename nativeType>
+    friend class SHEFpT;
 #ifdef DEBUG
   static SHEPrivateKey *debugPrivKey; // set for debugging
 #endif
   static std::ostream *log;
-  static uint64_t nextTmp;
-  static SHEFpLabelHash labelHash;
+  static std::atomic<uint64_t> nextTmp;
   SHEInt sign;
   SHEInt exp;
   SHEInt mantissa;
   char labelBuf[SHEINT_MAX_LABEL_SIZE];
+  mutable const char *labelPtr = nullptr; // label, labelBuf or nullptr
   // helper
   // setNextLabel lies about const since it's basically a caching function
   const char *setNextLabel(void) const { uint64_t current=nextTmp++;
     snprintf((char *)&labelBuf[0], sizeof(labelBuf), "t%d",current);
-    labelHash[this]=labelBuf;
+    labelPtr=labelBuf;
     return labelBuf;
   }
 
@@ -68,10 +71,13 @@ protected:
   // raw GT comparison that ignores Nans
   SHEBool rawGT(const SHEFp &a) const;
   SHEBool rawGE(const SHEFp &a) const;
+  // add without reconciling the exponent and mantissa sizes
+  SHEFp addSameSize(const SHEFp &a) const;
+  // normalize for tiny mantissas
+  void normalizeSmall(void);
 
 public:
    static constexpr std::string_view typeName = "SHEFp";
-  ~SHEFp(void) { labelHash.erase(this); }
   // copy operators
   SHEFp(const SHEPublicKey &pubkey, shemaxfloat_t val,
         int expSize, int mantissaSize, const char *label=nullptr);
@@ -79,7 +85,7 @@ public:
         sign(pubkey), exp(pubkey), mantissa(pubkey) { resetNative(); }
   SHEFp(const SHEFp &a, const char *label) :
      sign(a.sign), exp(a.exp), mantissa(a.mantissa)
-  { if (label) { labelHash[this] = label; } }
+  { if (label) { labelPtr = label; } }
   SHEFp(const SHEFp &a) :
      sign(a.sign), exp(a.exp), mantissa(a.mantissa)  {}
   SHEFp &operator=(const SHEFp &a)
@@ -194,6 +200,7 @@ public:
   const SHEInt &getSign(void) const { return sign; }
   const SHEInt &getExp(void) const { return exp; }
   const SHEInt &getMantissa(void) const { return mantissa; }
+  const SHEPublicKey &getPublicKey(void) const { return sign.getPublicKey(); }
   SHEInt getUnbiasedExp(void) const ;
   void setUnbiasedExp(int64_t);
   void setUnbiasedExp(const SHEInt &);
@@ -204,7 +211,7 @@ public:
   void setMantissa(const SHEInt &mantissa_)
   { mantissa = mantissa_; resetNative(); normalize(); }
   const char *getLabel(void) const
-  {const char *label = labelHash[this];
+  {const char *label = labelPtr;
    if (label) return label;
    return setNextLabel(); }
   // switch size and signedness
@@ -342,32 +349,103 @@ public:
   }
 };
 
-// now define the various native types
-// would the be better as a template?
+///////////////////////////////////////////////////////////////////////////
+//                      compile time sized floats                         /
+///////////////////////////////////////////////////////////////////////////
+// SHEFpT fixes the exponent and mantissa sizes at compile time. The bias
+// and the special exponent become constants, and arithmetic between two
+// values of the same SHEFpT type skips the size reconciliation (and the
+// resets that go with it) SHEFp has to do for arbitrarily sized operands.
+// Custom formats can be used directly, e.g. SHEFpT<6,11> is a 16 bit
+// float with more range and less precision than SHEHalfFloat.
+template<int expSize, int mantissaSize, typename nativeType=shemaxfloat_t>
+class SHEFpT : public SHEFp {
+  static_assert(expSize > 1 && expSize < 64, "SHEFpT exponent size");
+  static_assert(mantissaSize > 2, "SHEFpT mantissa size");
+protected:
+  // only pay for the reset if the sizes actually changed
+  void resetNative(void)
+  { if ((exp.getSize() != expSize) ||
+        (mantissa.getSize() != mantissaSize)) {
+      reset(expSize, mantissaSize);
+    }
+  }
+public:
+  static constexpr std::string_view typeName = "SHEFpT";
+  static constexpr int exponentBits = expSize;
+  static constexpr int mantissaBits = mantissaSize;
+  static constexpr uint64_t biasExp = (1ULL << (expSize-1))-1;
+  static constexpr uint64_t specialExp = (1ULL << expSize)-1;
+
+  SHEFpT(const SHEPublicKey &pubKey, const char *label_=nullptr) :
+    SHEFp(pubKey, (shemaxfloat_t)0.0, expSize, mantissaSize, label_) {}
+  SHEFpT(const SHEPublicKey &pubKey,
+         const unsigned char *encryptedInt, int dataSize,
+         const char *label_=nullptr) :
+    SHEFp(pubKey, encryptedInt, dataSize, label_) { resetNative(); }
+  SHEFpT(const SHEPublicKey &pubKey, nativeType myfloat,
+         const char *label_=nullptr) :
+    SHEFp(pubKey, (shemaxfloat_t)myfloat, expSize, mantissaSize, label_) {}
+  SHEFpT(const SHEFp &a, const char *label_) : SHEFp(a, label_)
+    { resetNative(); }
+  SHEFpT(const SHEFp &a) : SHEFp(a) { resetNative(); }
+  SHEFpT(const SHEFp &model, nativeType a, const char *label_=nullptr)
+    : SHEFp(model, (shemaxfloat_t)a, label_) { resetNative(); }
+  SHEFpT &operator=(nativeType a)
+    { SHEFp a_(*this,(shemaxfloat_t)a); SHEFp::operator=(a_); return *this; }
+  nativeType decrypt(const SHEPrivateKey &privKey) const
+    { return (nativeType) decryptRaw(privKey); }
+
+  // same type arithmetic. The operands are known to be the same size,
+  // so we go straight to the raw operations. Mixed types fall back to
+  // the SHEFp operators.
+  using SHEFp::operator+;
+  using SHEFp::operator-;
+  using SHEFp::operator*;
+  using SHEFp::operator/;
+  using SHEFp::operator+=;
+  using SHEFp::operator-=;
+  using SHEFp::operator*=;
+  using SHEFp::operator/=;
+  SHEFpT operator+(const SHEFpT &a) const { return addSameSize(a); }
+  SHEFpT operator-(const SHEFpT &a) const { return addSameSize(-a); }
+  SHEFpT operator*(const SHEFpT &a) const { return SHEFp::operator*(a); }
+  SHEFpT operator/(const SHEFpT &a) const { return SHEFp::operator/(a); }
+  SHEFpT &operator+=(const SHEFpT &a) { return *this = *this + a; }
+  SHEFpT &operator-=(const SHEFpT &a) { return *this = *this - a; }
+  SHEFpT &operator*=(const SHEFpT &a) { return *this = *this * a; }
+  SHEFpT &operator/=(const SHEFpT &a) { return *this = *this / a; }
+
+  // select without the resets SHEFp select needs to match sizes
+  static SHEFpT selectSameSize(const SHEInt &sel, const SHEFpT &a_true,
+                               const SHEFpT &a_false)
+  {
+    SHEFpT result(a_true);
+    result.sign = sel.select(a_true.sign, a_false.sign);
+    result.exp = sel.select(a_true.exp, a_false.exp);
+    result.mantissa = sel.select(a_true.mantissa, a_false.mantissa);
+    return result;
+  }
+};
+
+template<int expSize, int mantissaSize, typename nativeType>
+inline SHEFpT<expSize, mantissaSize, nativeType>
+select(const SHEInt &sel, const SHEFpT<expSize, mantissaSize, nativeType> &a_true,
+       const SHEFpT<expSize, mantissaSize, nativeType> &a_false)
+{
+  return SHEFpT<expSize, mantissaSize, nativeType>::selectSameSize(sel,
+                                                            a_true, a_false);
+}
+
+// now define the various native types on top of SHEFpT
 #define NEW_FP_CLASS(name, type, expSize, mantissaSize) \
-class name : public SHEFp { \
-protected:           \
-    virtual void resetNative(void)  { reset(expSize, mantissaSize); } \
+class name : public SHEFpT<expSize, mantissaSize, type> { \
 public:              \
+    typedef SHEFpT<expSize, mantissaSize, type> SHEFpBase; \
     static constexpr std::string_view typeName = #name; \
-    name(const SHEPublicKey &pubKey, const char *label_=nullptr) : \
-      SHEFp(pubKey, (shemaxfloat_t)0.0, expSize, mantissaSize, label_) {} \
-    name(const SHEPublicKey &pubKey, \
-         const unsigned char *encryptedInt, int dataSize, \
-         const char *label_=nullptr) : \
-            SHEFp(pubKey, encryptedInt, dataSize, label_) { resetNative(); } \
-    name(const SHEPublicKey &pubKey, type myfloat, const char *label_=nullptr):\
-            SHEFp(pubKey, (shemaxfloat_t)myfloat, expSize, mantissaSize, label_) {} \
-    name(const SHEFp &a, const char *label_) : SHEFp(a, label_) \
-            { resetNative(); } \
-    name(const SHEFp &a) : SHEFp(a) { resetNative(); } \
-    name(const SHEFp &model, type a, const char *label_=nullptr) \
-         : SHEFp(model, (shemaxfloat_t)a, label_) \
-            { resetNative(); } \
+    using SHEFpBase::SHEFpBase; \
     name &operator=(type a) \
-             { SHEFp a_(*this,(shemaxfloat_t)a); return *this=a_; } \
-    type decrypt(const SHEPrivateKey &privKey) const  \
-            { return (type) decryptRaw(privKey); }; \
+             { SHEFpBase::operator=(a); return *this; } \
 }; \
 //inline name operator[](const std::vector<type> &a,  const SHEInt &index) \
 //{ \
@@ -423,5 +501,13 @@ NEW_FP_CLASS(SHEFloat,         shefloat32_t,   8,  25)
 NEW_FP_CLASS(SHEDouble,        shefloat64_t,  11,  54)
 NEW_FP_CLASS(SHEExtendedFloat, shefloat128_t, 15,  66)
 NEW_FP_CLASS(SHELongDouble,    shefloat128_t, 15, 114)
+// 8 bit floats for encrypted ML. Every mantissa bit is expensive here,
+// so these only keep the explicit high bit and drop the extra precision
+// bit. We use IEEE style special values, and the explicit high bit costs
+// a mantissa bit, so E4M3 tops out at 120 rather than the 448 of the OCP
+// format (which has no infinity).
+// Both are small enough for the table normalize and lookup multiply.
+NEW_FP_CLASS(SHEFloat8E4M3,    float,          4,   4)
+NEW_FP_CLASS(SHEFloat8E5M2,    float,          5,   3)
 
 #endif
@@ -0,0 +1,203 @@
+//
+// evaluate arbitrary functions of small encrypted integers by table lookup
+//
+#ifndef SHEFunctionTable_H_
+#define SHEFunctionTable_H_ 1
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include "SHEInt.h"
+#include "SHEConfig.h"
+
+//
+// The function is run in the clear on every possible input when the table
+// is built, so it can be any C++ callable: an activation function, a
+// character class, a saturating conversion. The encrypted input only picks
+// the row. Inputs are limited to SHEINT_MAX_DECODE_BITS bits (an 8 bit
+// input is a 256 row table). A table can hold several outputs per row,
+// which are all read from the same decode of the input.
+//
+// There are two ways to read the table:
+//
+// SHETableOneHot decodes the input once into 2^n one hot bits, about 2^n
+// ANDs at depth log2(n). Since exactly one of them is set, each output bit
+// is the XOR of the one hot bits whose row has that bit set, and XOR is
+// free. Every output, and every other table on the same input (see
+// decode()), shares the one decode, and the depth doesn't depend on the
+// function.
+//
+// SHETableMuxTree folds the table in half on each input bit, low bit
+// first. The first level is free (the rows are plaintext, so each pair is
+// 0, 1, bit or !bit), each level after that costs one select per node, so
+// each output bit is about 2^(n-1) selects at depth n. It never holds the
+// 2^n decoded bits, so it suits a single narrow output from a large table.
+//
+enum SHETableMode {
+  SHETableOneHot,
+  SHETableMuxTree
+};
+
+class SHEFunctionTable {
+private:
+  int inputBits;
+  bool inputUnsigned;
+  int outputBits;
+  bool outputUnsigned;
+  // entry[output][row], row is the raw bits of the input
+  std::vector<std::vector<uint64_t>> entry;
+
+  // the input value for a row, sign extended for signed inputs
+  int64_t rowValue(uint64_t row) const
+  {
+    if (inputUnsigned || !(row & (1ULL << (inputBits-1)))) {
+      return (int64_t)row;
+    }
+    return (int64_t)(row | (~0ULL << inputBits));
+  }
+  void build(const std::function<std::vector<int64_t>(int64_t)> &f,
+             int outputs)
+  {
+    helib::assertTrue((inputBits > 0) &&
+                      (inputBits <= SHEINT_MAX_DECODE_BITS),
+                      "function table input too large to decode");
+    helib::assertTrue((outputBits > 0) && (outputBits <= 64),
+                      "function table outputs must fit in 64 bits");
+    uint64_t mask = (outputBits == 64) ? ~0ULL : (1ULL << outputBits)-1;
+    entry.assign(outputs, std::vector<uint64_t>(1ULL << inputBits));
+    for (uint64_t row=0; row < (1ULL << inputBits); row++) {
+      std::vector<int64_t> value = f(rowValue(row));
+      helib::assertTrue(value.size() == outputs,
+                        "function returned the wrong number of outputs");
+      for (int i=0; i < outputs; i++) {
+        entry[i][row] = (uint64_t)value[i] & mask;
+      }
+    }
+  }
+  SHEInt constantBit(const SHEInt &model, bool bit) const
+  { return SHEInt(model.getPublicKey(), (uint64_t)bit, 1, true); }
+  // assemble the output bits, LSB first, into an output sized integer
+  SHEInt pack(const std::vector<SHEInt> &bits) const
+  {
+    SHEInt result(bits[0]);
+    result.reset(outputBits, true);
+    for (int j=1; j < outputBits; j++) {
+      SHEInt bit(bits[j]);
+      bit.reset(outputBits, true);
+      bit <<= j;
+      result ^= bit;
+    }
+    result.reset(outputBits, outputUnsigned);
+    return result;
+  }
+  // output bit j of output i by mux tree
+  SHEInt muxBit(const SHEInt &index, int i, int j) const
+  {
+    const std::vector<uint64_t> &rows = entry[i];
+    SHEInt low(index.getBit(0));
+    std::vector<SHEInt> level;
+    for (uint64_t row=0; row < rows.size(); row += 2) {
+      bool b0 = (rows[row] >> j) & 1;
+      bool b1 = (rows[row+1] >> j) & 1;
+      if (b0 == b1) {
+        level.push_back(constantBit(index, b0));
+      } else {
+        level.push_back(b1 ? low : !low);
+      }
+    }
+    for (int bit=1; bit < inputBits; bit++) {
+      SHEInt sel(index.getBit(bit));
+      std::vector<SHEInt> next;
+      for (int k=0; k < level.size(); k += 2) {
+        next.push_back(sel.select(level[k+1], level[k]));
+      }
+      level = next;
+    }
+    return level[0];
+  }
+
+public:
+  // single output
+  SHEFunctionTable(const std::function<int64_t(int64_t)> &f, int inputBits_,
+                   int outputBits_, bool inputUnsigned_=true,
+                   bool outputUnsigned_=true) :
+                   inputBits(inputBits_), inputUnsigned(inputUnsigned_),
+                   outputBits(outputBits_), outputUnsigned(outputUnsigned_)
+  { build([&f](int64_t x) { return std::vector<int64_t>(1, f(x)); }, 1); }
+  // f returns one value for each of the outputs
+  SHEFunctionTable(const std::function<std::vector<int64_t>(int64_t)> &f,
+                   int outputs, int inputBits_, int outputBits_,
+                   bool inputUnsigned_=true, bool outputUnsigned_=true) :
+                   inputBits(inputBits_), inputUnsigned(inputUnsigned_),
+                   outputBits(outputBits_), outputUnsigned(outputUnsigned_)
+  { build(f, outputs); }
+  SHEFunctionTable(const SHEFunctionTable &a) : inputBits(a.inputBits),
+                   inputUnsigned(a.inputUnsigned), outputBits(a.outputBits),
+                   outputUnsigned(a.outputUnsigned), entry(a.entry) {}
+
+  // accessor functions
+  int getInputBits(void) const { return inputBits; }
+  int getOutputBits(void) const { return outputBits; }
+  int getOutputs(void) const { return entry.size(); }
+  const std::vector<uint64_t> &getEntries(int output=0) const
+  { return entry[output]; }
+
+  // the one hot decode of an input, to share between tables on the same
+  // input. Only the low inputBits of index are used.
+  std::vector<SHEInt> decode(const SHEInt &index) const
+  {
+    SHEInt row(index);
+    row.reset(inputBits, true);
+    return row.decode();
+  }
+
+  // evaluate from a decode (one hot)
+  SHEInt evaluate(const std::vector<SHEInt> &oneHot, int output=0) const
+  {
+    helib::assertTrue(oneHot.size() == entry[output].size(),
+                      "decode doesn't match the function table input size");
+    const std::vector<uint64_t> &rows = entry[output];
+    std::vector<SHEInt> bits;
+    for (int j=0; j < outputBits; j++) {
+      SHEInt bit(constantBit(oneHot[0], false));
+      bool first = true;
+      for (uint64_t row=0; row < rows.size(); row++) {
+        if ((rows[row] >> j) & 1) {
+          bit = first ? oneHot[row] : bit ^ oneHot[row];
+          first = false;
+        }
+      }
+      bits.push_back(bit);
+    }
+    return pack(bits);
+  }
+  std::vector<SHEInt> evaluateAll(const std::vector<SHEInt> &oneHot) const
+  {
+    std::vector<SHEInt> result;
+    for (int i=0; i < entry.size(); i++) {
+      result.push_back(evaluate(oneHot, i));
+    }
+    return result;
+  }
+
+  // evaluate from the encrypted input
+  SHEInt evaluate(const SHEInt &index, int output=0,
+                  SHETableMode mode=SHETableOneHot) const
+  {
+    if (mode == SHETableOneHot) {
+      return evaluate(decode(index), output);
+    }
+    SHEInt row(index);
+    row.reset(inputBits, true);
+    std::vector<SHEInt> bits;
+    for (int j=0; j < outputBits; j++) {
+      bits.push_back(muxBit(row, output, j));
+    }
+    return pack(bits);
+  }
+  // all the outputs, from one decode
+  std::vector<SHEInt> evaluateAll(const SHEInt &index) const
+  { return evaluateAll(decode(index)); }
+  SHEInt operator()(const SHEInt &index) const { return evaluate(index); }
+};
+
+#endif
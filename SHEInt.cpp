@@ -2,6 +2,8 @@
 // implement basic integer operations for Homomorphic values
 //
 #include <iostream>
+#include <algorithm>
+#include <thread>
 #include "SHEInt.h"
 #include "SHEKey.h"
 #include "SHEUtil.h"
@@ -10,6 +12,7 @@
 #include <helib/binaryArith.h>
 #include <helib/binaryCompare.h>
 #include <helib/intraSlot.h>
+#include <NTL/BasicThreadPool.h>
 #include "helibio.h"
 
 #ifdef DEBUG
@@ -17,9 +20,8 @@ SHEPrivateKey *SHEInt::debugPrivKey = nullptr;
 #endif
 
 std::ostream *SHEInt::log = nullptr;
-uint64_t SHEInt::nextTmp = 0;
-SHEIntLabelHash SHEInt::labelHash;
-SHERecryptCounters SHEInt::recryptCounters = { 0 };
+std::atomic<uint64_t> SHEInt::nextTmp(0);
+thread_local SHERecryptCounters SHEInt::recryptCounters = { 0 };
 
 static std::vector<helib::Ctxt> &
 sheInt_Encrypt(const SHEPublicKey &pubKey,
@@ -31,13 +33,12 @@ sheInt_Encrypt(const SHEPublicKey &pubKey,
   const helib::EncryptedArray &ea = pubKey.getEncryptedArray();
 
   encryptedData = std::vector<helib::Ctxt>(bitSize,ctxtTemplate);
-  for (int i=0; i < bitSize; i++) {
-    std::vector<long> vec(ea.size());
-    for (auto& slot: vec) {
-      slot = (myint >> i) & 1;
-    }
+  NTL_EXEC_RANGE(bitSize, first, last)
+  for (long i=first; i < last; i++) {
+    std::vector<long> vec(ea.size(), (myint >> i) & 1);
     ea.encrypt(encryptedData[i], helibPubKey, vec);
   }
+  NTL_EXEC_RANGE_END
   return encryptedData;
 }
 
@@ -46,7 +47,7 @@ SHEInt::SHEInt(const SHEPublicKey &pubKey_, uint64_t myInt,
               pubKey(&pubKey_), bitSize(bitSize_),
               isUnsigned(isUnsigned_)
 {
-  if (label) labelHash[this]=label;
+  if (label) labelPtr = label;
   isExplicitZero = !myInt;
   // if myInt is zero, delay creating the encrypted data. The rest of the
   // functions will recognize an isExplicitZero
@@ -58,7 +59,7 @@ SHEInt::SHEInt(const SHEPublicKey &pubKey_, uint64_t myInt,
 SHEInt::SHEInt(const SHEInt &model, uint64_t myInt,const char *label)
                : pubKey(model.pubKey)
 {
-  if (label) labelHash[this]=label;
+  if (label) labelPtr = label;
   bitSize = model.bitSize;
   isUnsigned = model.isUnsigned;
   isExplicitZero = !myInt;
@@ -72,7 +73,7 @@ SHEInt::SHEInt(const SHEInt &model, uint64_t myInt,const char *label)
 SHEInt::SHEInt(const SHEPublicKey &pubKey_, const unsigned char *encryptedInt,
              int size, const char *label) : pubKey(&pubKey_)
 {
-  if (label) labelHash[this]=label;
+  if (label) labelPtr = label;
   std::string s((const char *)encryptedInt, size);
   std::stringstream ss(s);
   read(ss);
@@ -81,7 +82,7 @@ SHEInt::SHEInt(const SHEPublicKey &pubKey_, const unsigned char *encryptedInt,
 SHEInt::SHEInt(const SHEPublicKey &pubKey_, std::istream& str,
                const char *label) : pubKey(&pubKey_)
 {
-  if (label) labelHash[this]=label;
+  if (label) labelPtr = label;
   readFromJSON(str);
 }
 
@@ -103,12 +104,16 @@ void SHEInt::reset(int newBitSize, bool newIsUnsigned)
   // we extend the sign bit. truncation looses
   // the high bits.
   helib::Ctxt ctxtTemplate(pubKey->getPublicKey());
-  if (isUnsigned) {
-    ctxtTemplate.clear();
-  } else {
-    ctxtTemplate = encryptedData[bitSize-1];
-  }
+  ctxtTemplate.clear();
   encryptedData.resize(newBitSize, ctxtTemplate);
+  if (!isUnsigned && (newBitSize > bitSize)) {
+    const helib::Ctxt &sign = encryptedData[bitSize-1];
+    NTL_EXEC_RANGE(newBitSize-bitSize, first, last)
+    for (long i=first; i < last; i++) {
+      encryptedData[bitSize+i] = sign;
+    }
+    NTL_EXEC_RANGE_END
+  }
   bitSize = newBitSize;
 }
 
@@ -405,6 +410,46 @@ void SHEInt::reCrypt(SHEInt &a, bool force)
   }
 }
 
+// CtPtrs over the bits of any number of SHEInts
+struct CtPtrs_list : helib::CtPtrs
+{
+  std::vector<helib::Ctxt *> ctxt;
+  long size() const override { return ctxt.size(); }
+  helib::Ctxt *operator[](long i) const override { return ctxt[i]; }
+};
+
+void SHEInt::reCrypt(const std::vector<SHEInt *> &values, bool force)
+{
+  CtPtrs_list list;
+  std::vector<SHEInt *> packed;
+  for (auto value : values) {
+    if (value->isExplicitZero ||
+        (std::find(packed.begin(), packed.end(), value) != packed.end())) {
+      continue;
+    }
+    if (!force && (value->bitCapacity() > SHEINT_LEVEL_THRESHOLD)) {
+      continue;
+    }
+    packed.push_back(value);
+    for (auto &bit : value->encryptedData) {
+      list.ctxt.push_back(&bit);
+    }
+  }
+  if (packed.size() == 0) {
+    return;
+  }
+  const SHEPublicKey *pubKey = packed[0]->pubKey;
+  if (log) {
+    (*log) << "[Recrypt(" << packed.size() << " values)->" << std::flush;
+  }
+  helib::packedRecrypt(list,
+            *(std::vector<helib::zzX> *)pubKey->getUnpackSlotEncoding(),
+            pubKey->getEncryptedArray());
+  packed[0]->reCryptCounter();
+  if (log) {
+    (*log) << "]" << std::flush;
+  }
+}
 
 void SHEInt::reCrypt(bool force)
 {
@@ -471,6 +516,16 @@ void SHEInt::verifyArgs(long level)
   }
 }
 
+void SHEInt::verifyArgs(const std::vector<SHEInt *> &values, long level)
+{
+  for (auto value : values) {
+    if (value->needRecrypt(level)) {
+      reCrypt(values, false);
+      return;
+    }
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////
 //                      input/output operators.                           /
 ///////////////////////////////////////////////////////////////////////////
@@ -670,13 +725,22 @@ uint64_t SHEInt::decryptRaw(const SHEPrivateKey &privKey) const
   if (isExplicitZero) {
     return 0;
   }
-  uint64_t result;
-  std::vector<long> decrypted_result;
-  helib::CtPtrs_vectorCt wrapper((std::vector<helib::Ctxt>&)encryptedData);
+  uint64_t result = 0;
+  std::vector<uint64_t> bits(bitSize);
+  const helib::EncryptedArray &ea = pubKey->getEncryptedArray();
 
-  helib::decryptBinaryNums(decrypted_result, wrapper, privKey.getPrivateKey(),
-                           pubKey->getEncryptedArray());
-  result = decrypted_result.back();
+  // decrypt the bits in parallel, using the last slot like
+  // helib::decryptBinaryNums
+  NTL_EXEC_RANGE(bitSize, first, last)
+  for (long i=first; i < last; i++) {
+    std::vector<long> slots;
+    ea.decrypt(encryptedData[i], privKey.getPrivateKey(), slots);
+    bits[i] = slots.back() & 1;
+  }
+  NTL_EXEC_RANGE_END
+  for (int i=0; i < bitSize && i < 64; i++) {
+    result |= bits[i] << i;
+  }
   if (!isUnsigned) {
     // sign extend for signed values
     uint64_t sign=(result >> (bitSize-1)) & 1;
@@ -737,6 +801,26 @@ helib::Ctxt SHEInt::selectBit(const helib::Ctxt &trueBit,
   return ::selectBit(encryptedData[0], trueBit, falseBit);
 }
 
+// bits == value, for the low bits.size() bits of value. Works only on
+// helib ciphertexts so it can run on the thread pool.
+static helib::Ctxt equalBit(const std::vector<helib::Ctxt> &bits,
+                            uint64_t value)
+{
+  std::vector<helib::Ctxt> terms(bits);
+  for (int j=0; j < terms.size(); j++) {
+    if (((j < 64) ? (value >> j) & 1 : 0) == 0) {
+      terms[j].addConstant(NTL::ZZX(1L));
+    }
+  }
+  // multiply the terms as a tree to keep the depth down
+  for (int step=1; step < terms.size(); step *= 2) {
+    for (int j=0; j+step < terms.size(); j += 2*step) {
+      terms[j].multiplyBy(terms[j+step]);
+    }
+  }
+  return terms[0];
+}
+
 //
 // return the bit indexed by and encrypted 'index+offset'. This is equivalent to
 // encryptedArray[i], except 'i' is encrypted. The use of the unencrypted
@@ -749,10 +833,18 @@ helib::Ctxt SHEInt::selectArrayBit(const SHEInt &index, int offset,
                                    int direction,
                                    const helib::Ctxt &defaultBit) const
 {
-  SHEInt thisBit(*pubKey, 0, 1, true);
   helib::Ctxt selectedBit = defaultBit;
-  for (int i=0; i < bitSize; i++) {
+  // the compares are independent, so do them all at once
+  SHEInt fullIndex(index);
+  fullIndex.expandZero();
+  std::vector<helib::Ctxt> match(bitSize, defaultBit);
+  NTL_EXEC_RANGE(bitSize, first, last)
+  for (long i=first; i < last; i++) {
     int cmpIndex= direction?offset-i:i-offset;
+    match[i] = equalBit(fullIndex.encryptedData, (uint64_t)(int64_t)cmpIndex);
+  }
+  NTL_EXEC_RANGE_END
+  for (int i=0; i < bitSize; i++) {
     if (selectedBit.bitCapacity() < SHEINT_DEFAULT_LEVEL_TRIGGER) {
       // it's posible we hit the capacity mid loop, recrypt if necessary
       const helib::PubKey &publicKey = pubKey->getPublicKey();
@@ -763,8 +855,7 @@ helib::Ctxt SHEInt::selectArrayBit(const SHEInt &index, int offset,
       publicKey.reCrypt(selectedBit);
       reCryptBitCounter();
     }
-    selectedBit = (index == cmpIndex).selectBit(encryptedData[i],
-                                                  selectedBit);
+    selectedBit = ::selectBit(match[i], encryptedData[i], selectedBit);
   }
   return selectedBit;
 }
@@ -921,28 +1012,42 @@ void SHEInt::rightShift(uint64_t shift)
 //
 // Shift by an encrypted shift index requires logical operaters.
 // Note: unlike integer shifts, these are more expensive in both time
-// (O(bitSize^2) single bit multiplies and a xor) and capacity.
+// and capacity. They are barrel shifters: stage k shifts by 2^k if bit k
+// of shift is set, so it's O(bitSize*log(bitSize)) single bit multiplies,
+// and each stage is one select whose bits run in parallel.
 SHEInt &SHEInt::leftShift(const SHEInt &shift, SHEInt &result) const
 {
-  // walk down the possible shifts and return the one that matches
-  result = SHEInt(*this, (uint64_t)0);
-
-  for (int i=0; i < bitSize; i++) {
-    result = (i==shift).select(*this << i, result);
+  result = *this;
+  int stage;
+  for (stage=0; (stage < shift.bitSize) && ((1 << stage) < bitSize);
+       stage++) {
+    result = shift.getBit(stage).select(result << (uint64_t)(1 << stage),
+                                        result);
+  }
+  // shifts of bitSize or more clear every bit
+  if (stage < shift.bitSize) {
+    result = (shift >> (uint64_t)stage).isZero().select(result, 0);
   }
   return result;
 }
 
 SHEInt &SHEInt::rightShift(const SHEInt &shift, SHEInt &result) const
 {
-  // walk down the possible shifts and return the one that matches
-  result = SHEInt(*this, (uint64_t)0);
-  if (!isUnsigned) {
-    result=isNegative().select(-1,result);
+  result = *this;
+  int stage;
+  for (stage=0; (stage < shift.bitSize) && ((1 << stage) < bitSize);
+       stage++) {
+    result = shift.getBit(stage).select(result >> (uint64_t)(1 << stage),
+                                        result);
   }
-
-  for (int i=0; i < bitSize; i++) {
-    result = (i==shift).select(*this >> i, result);
+  // shifts of bitSize or more leave just the sign
+  if (stage < shift.bitSize) {
+    SHEInt overflow((shift >> (uint64_t)stage).isNotZero());
+    if (isUnsigned) {
+      result = overflow.select(0, result);
+    } else {
+      result = overflow.select(*this >> (uint64_t)(bitSize-1), result);
+    }
   }
   return result;
 }
@@ -1532,6 +1637,69 @@ SHEInt SHEInt::operator--(int dummy)
   return result;
 }
 
+///////////////////////////////////////////////////////////////////////////
+//                      Per bit kernels.                                  /
+///////////////////////////////////////////////////////////////////////////
+//
+// Each bit of a bitwise operation is an independent ciphertext operation,
+// so the bits are spread across the NTL thread pool. The kernels only
+// touch helib ciphertexts, never SHEInt state. Operands are the same size.
+void SHEInt::setThreads(int threads)
+{
+  if (threads <= 0) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  NTL::SetNumThreads(threads);
+}
+
+int SHEInt::getThreads(void)
+{
+  return NTL::AvailableThreads();
+}
+
+static void bitwiseAnd(std::vector<helib::Ctxt> &a,
+                       const std::vector<helib::Ctxt> &b)
+{
+  NTL_EXEC_RANGE(a.size(), first, last)
+  for (long i=first; i < last; i++) {
+    a[i].multiplyBy(b[i]);
+  }
+  NTL_EXEC_RANGE_END
+}
+
+static void bitwiseXOR(std::vector<helib::Ctxt> &a,
+                       const std::vector<helib::Ctxt> &b)
+{
+  NTL_EXEC_RANGE(a.size(), first, last)
+  for (long i=first; i < last; i++) {
+    a[i] += b[i];
+  }
+  NTL_EXEC_RANGE_END
+}
+
+// a | b = a ^ b ^ (a & b)
+static void bitwiseOr(std::vector<helib::Ctxt> &a,
+                      const std::vector<helib::Ctxt> &b)
+{
+  NTL_EXEC_RANGE(a.size(), first, last)
+  for (long i=first; i < last; i++) {
+    helib::Ctxt both(a[i]);
+    both.multiplyBy(b[i]);
+    a[i] += b[i];
+    a[i] += both;
+  }
+  NTL_EXEC_RANGE_END
+}
+
+static void bitwiseNot(std::vector<helib::Ctxt> &a)
+{
+  NTL_EXEC_RANGE(a.size(), first, last)
+  for (long i=first; i < last; i++) {
+    a[i].addConstant(NTL::ZZX(1L));
+  }
+  NTL_EXEC_RANGE_END
+}
+
 ///////////////////////////////////////////////////////////////////////////
 //                      Bitwise operators.                                /
 ///////////////////////////////////////////////////////////////////////////
@@ -1543,8 +1711,7 @@ void SHEInt::bitNot(void)
   }
   if (log) (*log) << (SHEIntSummary) *this << ".bitwiseNot=" << std::flush;
   verifyArgs(SHEINT_DEFAULT_LEVEL_TRIGGER/2);
-  helib::CtPtrs_vectorCt wrapper(encryptedData);
-  helib::bitwiseNot(wrapper, wrapper);
+  ::bitwiseNot(encryptedData);
   if (log) (*log) << (SHEIntSummary) *this << std::endl;
 }
 
@@ -1577,13 +1744,11 @@ SHEInt SHEInt::operator^(const SHEInt &a) const
     result.reset(a.bitSize, isUnsigned);
   }
   result.verifyArgs(target);
-  helib::CtPtrs_vectorCt wrapper(result.encryptedData);
   if (log) {
     (*log) << (SHEIntSummary)*this << ".bitwiseXOR(" << (SHEIntSummary) a << ","
         << (SHEIntSummary)result << ")=" << std::flush;
   }
-  helib::bitwiseXOR(wrapper, wrapper,
-                    helib::CtPtrs_vectorCt(target.encryptedData));
+  ::bitwiseXOR(result.encryptedData, target.encryptedData);
   if (log) (*log) << (SHEIntSummary)result << std::endl;
   return result;
 }
@@ -1604,14 +1769,12 @@ SHEInt SHEInt::operator&(const SHEInt &a) const
   } else if (a.bitSize > result.bitSize) {
     result.reset(a.bitSize, isUnsigned);
   }
-  helib::CtPtrs_vectorCt wrapper(result.encryptedData);
   if (log) {
     (*log) << (SHEIntSummary)*this << ".bitwiseAnd(" << (SHEIntSummary) a << ","
         << (SHEIntSummary)result << ")=" << std::flush;
   }
   result.verifyArgs(target);
-  helib::bitwiseAnd(wrapper, wrapper,
-                    helib::CtPtrs_vectorCt(target.encryptedData));
+  ::bitwiseAnd(result.encryptedData, target.encryptedData);
   if (log) (*log) << (SHEIntSummary)result << std::endl;
   return result;
 }
@@ -1633,15 +1796,11 @@ SHEInt SHEInt::operator|(const SHEInt &a) const
     result.reset(a.bitSize, isUnsigned);
   }
   result.verifyArgs(target);
-  // bitwiseOr can't handle input and output buffers being the same
-  std::vector<helib::Ctxt> lhs = result.encryptedData;
-  helib::CtPtrs_vectorCt wrapper(result.encryptedData);
   if (log) {
     (*log) << (SHEIntSummary)*this << ".bitwiseOr(" << (SHEIntSummary) a << ","
         << (SHEIntSummary)result << ")=" << std::flush;
   }
-  helib::bitwiseOr(wrapper,helib::CtPtrs_vectorCt(lhs),
-                   helib::CtPtrs_vectorCt(target.encryptedData));
+  ::bitwiseOr(result.encryptedData, target.encryptedData);
   if (log) (*log) << (SHEIntSummary)result << std::endl;
   return result;
 }
@@ -1664,9 +1823,7 @@ SHEInt &SHEInt::operator^=(const SHEInt &a)
     reset(a.bitSize, isUnsigned);
   }
   verifyArgs(target);
-  helib::CtPtrs_vectorCt wrapper(encryptedData);
-  helib::bitwiseXOR(wrapper, wrapper,
-                    helib::CtPtrs_vectorCt(target.encryptedData));
+  ::bitwiseXOR(encryptedData, target.encryptedData);
   return *this;
 }
 
@@ -1687,9 +1844,7 @@ SHEInt &SHEInt::operator&=(const SHEInt &a)
     reset(a.bitSize, isUnsigned);
   }
   verifyArgs(target);
-  helib::CtPtrs_vectorCt wrapper(encryptedData);
-  helib::bitwiseAnd(wrapper, wrapper,
-                    helib::CtPtrs_vectorCt(target.encryptedData));
+  ::bitwiseAnd(encryptedData, target.encryptedData);
   return *this;
 }
 
@@ -1710,11 +1865,7 @@ SHEInt &SHEInt::operator|=(const SHEInt &a)
     reset(a.bitSize, isUnsigned);
   }
   verifyArgs(target);
-  // bitwiseOr can't handle overlapped buffers
-  std::vector<helib::Ctxt> lhs = encryptedData;
-  helib::CtPtrs_vectorCt wrapper(encryptedData);
-  helib::bitwiseOr(wrapper,helib::CtPtrs_vectorCt(lhs),
-                   helib::CtPtrs_vectorCt(target.encryptedData));
+  ::bitwiseOr(encryptedData, target.encryptedData);
   return *this;
 }
 
@@ -2198,6 +2349,398 @@ SHEInt SHEInt::select(uint64_t a_true, uint64_t a_false) const
 }
 
 
+// decode the bits [low, low+count) into one hot bits. We split the bits
+// in half and cross the two halves so the AND depth stays log(count).
+static void decodeBits(const SHEInt &a, int low, int count,
+                       std::vector<SHEInt> &out)
+{
+  if (count == 1) {
+    SHEInt bit = a.getBit(low);
+    out.push_back(!bit);
+    out.push_back(bit);
+    return;
+  }
+  std::vector<SHEInt> lowHot;
+  std::vector<SHEInt> highHot;
+  int half = count/2;
+  decodeBits(a, low, half, lowHot);
+  decodeBits(a, low+half, count-half, highHot);
+  out.reserve(lowHot.size()*highHot.size());
+  for (auto &high : highHot) {
+    for (auto &lowBit : lowHot) {
+      out.push_back(high && lowBit);
+    }
+  }
+}
+
+std::vector<SHEInt> SHEInt::decode(void) const
+{
+  helib::assertTrue(bitSize <= SHEINT_MAX_DECODE_BITS,
+                    "SHEInt too large to decode");
+  std::vector<SHEInt> out;
+  if (log) {
+    (*log) << (SHEIntSummary)*this << ".decode()" << std::endl;
+  }
+  decodeBits(*this, 0, bitSize, out);
+  return out;
+}
+
+// add up columns of single bit values, column[w] has weight 2^w, with a
+// carry save (wallace) tree. Each round compresses every column three to
+// two with full adders, carrying into the next column, until no column has
+// more than two bits. One adder then sums the two rows. The depth is about
+// log1.5(n) ANDs plus the final adder, rather than n adders in a chain.
+// The result wraps at width bits.
+static SHEInt sumColumns(const SHEPublicKey &pubKey,
+                         std::vector<std::vector<SHEInt>> column, int width)
+{
+  column.resize(width);
+  bool more = false;
+  for (auto &col : column) {
+    more = more || (col.size() > 2);
+  }
+  while (more) {
+    std::vector<std::vector<SHEInt>> next(width);
+    for (int w=0; w < width; w++) {
+      std::vector<SHEInt> &col = column[w];
+      int i = 0;
+      for (; i+2 < col.size(); i += 3) {
+        // sum = a^b^c, carry = maj(a,b,c) = ((a^c)&(b^c))^c
+        SHEInt ac(col[i] ^ col[i+2]);
+        next[w].push_back(ac ^ col[i+1]);
+        if (w+1 < width) {
+          next[w+1].push_back((ac & (col[i+1] ^ col[i+2])) ^ col[i+2]);
+        }
+      }
+      for (; i < col.size(); i++) {
+        next[w].push_back(col[i]);
+      }
+    }
+    column = next;
+    more = false;
+    for (auto &col : column) {
+      more = more || (col.size() > 2);
+    }
+  }
+  SHEInt row0(pubKey, (uint64_t)0, width, true);
+  SHEInt row1(pubKey, (uint64_t)0, width, true);
+  bool haveRow1 = false;
+  for (int w=0; w < width; w++) {
+    if (column[w].size() > 0) {
+      row0.setBit(w, column[w][0]);
+    }
+    if (column[w].size() > 1) {
+      row1.setBit(w, column[w][1]);
+      haveRow1 = true;
+    }
+  }
+  return haveRow1 ? row0 + row1 : row0;
+}
+
+static SHEInt countBits(const SHEPublicKey &pubKey,
+                        const std::vector<SHEInt> &bits, int width)
+{
+  std::vector<std::vector<SHEInt>> column(1, bits);
+  return sumColumns(pubKey, column, width);
+}
+
+// the common size and sign of a dot product, and its inputs sized to it
+static int dotProductSize(const std::vector<SHEInt> &a, bool &isUnsigned)
+{
+  int size = 0;
+  for (auto &term : a) {
+    size = std::max(size, term.getSize());
+    isUnsigned = isUnsigned && term.getUnsigned();
+  }
+  return size;
+}
+
+static SHEInt dotProductTerm(const SHEInt &a, int size)
+{
+  SHEInt term(a);
+  term.reset(size, a.getUnsigned());
+  return term;
+}
+
+// The low size bits of a two's complement product are the same as the
+// unsigned product of the sign extended inputs, so we only need the
+// partial products that land below size, and signed and unsigned terms
+// go in the same tree.
+SHEInt dotProduct(const std::vector<SHEInt> &a, const std::vector<SHEInt> &b)
+{
+  helib::assertTrue((a.size() == b.size()) && (a.size() > 0),
+                    "dot product needs two non-empty vectors of one size");
+  bool isUnsigned = true;
+  int size = std::max(dotProductSize(a, isUnsigned),
+                      dotProductSize(b, isUnsigned));
+  std::vector<std::vector<SHEInt>> column(size);
+  for (int k=0; k < a.size(); k++) {
+    if (a[k].isUnencryptedZero() || b[k].isUnencryptedZero()) {
+      continue;
+    }
+    SHEInt x(dotProductTerm(a[k], size));
+    SHEInt y(dotProductTerm(b[k], size));
+    for (int i=0; i < size; i++) {
+      SHEInt xi(x.getBit(i));
+      for (int j=0; i+j < size; j++) {
+        column[i+j].push_back(xi & y.getBit(j));
+      }
+    }
+  }
+  SHEInt result(sumColumns(a[0].getPublicKey(), column, size));
+  result.reset(size, isUnsigned);
+  return result;
+}
+
+// plaintext weights don't need any ANDs, each set bit of a weight adds a
+// shifted copy of the term's bits to the tree.
+SHEInt dotProduct(const std::vector<SHEInt> &a, const std::vector<int64_t> &b)
+{
+  helib::assertTrue((a.size() == b.size()) && (a.size() > 0),
+                    "dot product needs two non-empty vectors of one size");
+  bool isUnsigned = true;
+  int size = dotProductSize(a, isUnsigned);
+  for (auto weight : b) {
+    isUnsigned = isUnsigned && (weight >= 0);
+  }
+  std::vector<std::vector<SHEInt>> column(size);
+  for (int k=0; k < a.size(); k++) {
+    if (a[k].isUnencryptedZero()) {
+      continue;
+    }
+    SHEInt x(dotProductTerm(a[k], size));
+    uint64_t weight = (uint64_t)b[k];
+    for (int j=0; j < size; j++) {
+      // sizes past 64 bits sign extend the weight
+      if (((j < 64) ? (weight >> j) & 1 : (b[k] < 0)) == 0) {
+        continue;
+      }
+      for (int i=0; i+j < size; i++) {
+        column[i+j].push_back(x.getBit(i));
+      }
+    }
+  }
+  SHEInt result(sumColumns(a[0].getPublicKey(), column, size));
+  result.reset(size, isUnsigned);
+  return result;
+}
+
+// size a count of up to bitSize back to the size and sign of this
+static SHEInt countResult(const SHEInt &model, SHEInt count)
+{
+  count.reset(model.getSize(), true);
+  count.reset(model.getSize(), model.getUnsigned());
+  return count;
+}
+
+// bits needed to hold the values 0..n
+static int countWidth(int n)
+{
+  int width = 1;
+  while ((1 << width) <= n) {
+    width++;
+  }
+  return width;
+}
+
+static SHEInt predicateBit(const SHEInt &pred)
+{
+  return pred.getSize() == 1 ? pred : pred.isNotZero();
+}
+
+SHEInt countTrue(const std::vector<SHEInt> &pred)
+{
+  helib::assertTrue(pred.size() > 0, "count of an empty predicate vector");
+  std::vector<SHEInt> bits;
+  for (auto &p : pred) {
+    if (!p.isUnencryptedZero()) {
+      bits.push_back(predicateBit(p));
+    }
+  }
+  return countBits(pred[0].getPublicKey(), bits, countWidth(pred.size()));
+}
+
+SHEInt sumIf(const std::vector<SHEInt> &a, const std::vector<SHEInt> &pred)
+{
+  helib::assertTrue((a.size() == pred.size()) && (a.size() > 0),
+                    "sumIf needs values and predicates of one size");
+  bool isUnsigned = true;
+  int size = dotProductSize(a, isUnsigned);
+  std::vector<std::vector<SHEInt>> column(size);
+  for (int k=0; k < a.size(); k++) {
+    if (a[k].isUnencryptedZero() || pred[k].isUnencryptedZero()) {
+      continue;
+    }
+    SHEInt x(dotProductTerm(a[k], size));
+    SHEInt mask(predicateBit(pred[k]));
+    for (int i=0; i < size; i++) {
+      column[i].push_back(x.getBit(i) & mask);
+    }
+  }
+  SHEInt result(sumColumns(a[0].getPublicKey(), column, size));
+  result.reset(size, isUnsigned);
+  return result;
+}
+
+static SHEInt predicateTree(const std::vector<SHEInt> &pred, bool isAnd)
+{
+  helib::assertTrue(pred.size() > 0, "reduction of an empty predicate vector");
+  std::vector<SHEInt> level;
+  for (auto &p : pred) {
+    level.push_back(predicateBit(p));
+  }
+  while (level.size() > 1) {
+    std::vector<SHEInt> next;
+    for (int i=0; i+1 < level.size(); i += 2) {
+      next.push_back(isAnd ? level[i] && level[i+1] : level[i] || level[i+1]);
+    }
+    if (level.size() & 1) {
+      next.push_back(level.back());
+    }
+    level = next;
+  }
+  return level[0];
+}
+
+SHEInt anyTrue(const std::vector<SHEInt> &pred)
+{
+  return predicateTree(pred, false);
+}
+
+SHEInt allTrue(const std::vector<SHEInt> &pred)
+{
+  return predicateTree(pred, true);
+}
+
+SHEInt SHEInt::popcount(void) const
+{
+  if (log) {
+    (*log) << (SHEIntSummary)*this << ".popcount()" << std::endl;
+  }
+  if (isExplicitZero) {
+    return SHEInt(*this, (uint64_t)0);
+  }
+  std::vector<SHEInt> bits;
+  for (int i=0; i < bitSize; i++) {
+    bits.push_back(getBit(i));
+  }
+  return countResult(*this, countBits(*pubKey, bits, countWidth(bitSize)));
+}
+
+// prefix[k] is the OR of the top k+1 bits, built as a parallel prefix in
+// log2(bitSize) levels of ORs. Each prefix that is still zero is one more
+// leading zero, so clz is the count of the zero prefixes.
+SHEInt SHEInt::clz(void) const
+{
+  if (log) {
+    (*log) << (SHEIntSummary)*this << ".clz()" << std::endl;
+  }
+  if (isExplicitZero) {
+    return countResult(*this,
+                       SHEInt(*pubKey, (uint64_t)bitSize,
+                              countWidth(bitSize), true));
+  }
+  std::vector<SHEInt> prefix;
+  for (int k=0; k < bitSize; k++) {
+    prefix.push_back(getBitHigh(k));
+  }
+  for (int d=1; d < bitSize; d <<= 1) {
+    // go down so prefix[k-d] still holds the previous level
+    for (int k=bitSize-1; k >= d; k--) {
+      prefix[k] = prefix[k] || prefix[k-d];
+    }
+  }
+  for (auto &bit : prefix) {
+    bit = !bit;
+  }
+  return countResult(*this, countBits(*pubKey, prefix, countWidth(bitSize)));
+}
+
+SHEInt SHEInt::ctz(void) const
+{
+  return bitReverse().clz();
+}
+
+SHEInt SHEInt::parity(void) const
+{
+  if (log) {
+    (*log) << (SHEIntSummary)*this << ".parity()" << std::endl;
+  }
+  std::vector<SHEInt> level;
+  for (int i=0; i < bitSize; i++) {
+    level.push_back(getBit(i));
+  }
+  // XOR tree, XOR is free but the tree keeps the noise growth balanced
+  while (level.size() > 1) {
+    std::vector<SHEInt> next;
+    for (int i=0; i+1 < level.size(); i += 2) {
+      next.push_back(level[i] ^ level[i+1]);
+    }
+    if (level.size() & 1) {
+      next.push_back(level.back());
+    }
+    level = next;
+  }
+  return level[0];
+}
+
+// no operations at all, just reorder the bits
+SHEInt SHEInt::bitReverse(void) const
+{
+  SHEInt result(*this);
+  if (isExplicitZero) {
+    return result;
+  }
+  for (int i=0; i < bitSize; i++) {
+    result.encryptedData[i] = encryptedData[bitSize-1-i];
+  }
+  return result;
+}
+
+// digit by digit (restoring) square root, two bits of this per step from
+// the top. Each step does one subtract of the trial value 4*root+1 from
+// the remainder; the sign of the difference is the compare, so the same
+// subtract picks the next root bit and gives the new remainder.
+SHEInt SHEInt::isqrt(void) const
+{
+  if (log) {
+    (*log) << (SHEIntSummary)*this << ".isqrt()" << std::endl;
+  }
+  if (isExplicitZero) {
+    return *this;
+  }
+  // signed values only have bitSize-1 magnitude bits
+  int valueBits = isUnsigned ? bitSize : bitSize-1;
+  if (valueBits == 0) {
+    return SHEInt(*this, (uint64_t)0);
+  }
+  int steps = (valueBits+1)/2;
+  SHEInt value(*this);
+  value.reset(valueBits, true);
+  value.reset(steps*2, true);
+  // the remainder stays below 2*root+1, so steps+2 bits and a sign
+  int width = steps+3;
+  SHEInt root(*pubKey, (uint64_t)0, width, false);
+  SHEInt rem(*pubKey, (uint64_t)0, width, false);
+  for (int i=steps-1; i >= 0; i--) {
+    rem <<= 2;
+    rem.setBit(1, value.getBit(2*i+1));
+    rem.setBit(0, value.getBit(2*i));
+    SHEInt trial((root << 2) ^ (uint64_t)1);
+    SHEInt diff(rem - trial);
+    SHEInt fits(!diff.getBitHigh(0));
+    rem = fits.select(diff, rem);
+    root <<= 1;
+    root.setBit(0, fits);
+  }
+  root.reset(steps, true);
+  root = countResult(*this, root);
+  if (!isUnsigned) {
+    root = isNegative().select((uint64_t)0, root);
+  }
+  return root;
+}
+
 // && and || call themselves again if bitSize != 1 to reduce
 // down to a logical bit. Then we can do a bitwize &
 SHEInt SHEInt::operator&&(const SHEInt &a) const
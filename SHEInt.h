@@ -5,6 +5,7 @@
 #define SHEInt_H_ 1
 #include <cstdint>
 #include <iostream>
+#include <atomic>
 #include <helib/helib.h>
 #include "SHEKey.h"
 #include "SHEConfig.h"
@@ -84,7 +85,6 @@ inline std::ostream &operator<<(std::ostream &str,
 //
 //
 class SHEInt;
-typedef std::unordered_map<const SHEInt *,const char *>SHEIntLabelHash;
 
 class SHEInt {
 private:
@@ -93,15 +93,17 @@ private:
   static SHEPrivateKey *debugPrivKey; // set for debugging
 #endif
   static std::ostream *log;
-  static uint64_t nextTmp;
-  static SHEIntLabelHash labelHash;
-  static SHERecryptCounters recryptCounters;
+  // recrypt counters are kept per thread so threads can compute on
+  // different values at the same time.
+  static std::atomic<uint64_t> nextTmp;
+  static thread_local SHERecryptCounters recryptCounters;
   const SHEPublicKey *pubKey;
   int bitSize;              // how may bits in our int
   bool isUnsigned;          // treat this as a 2's complement binary value
   bool isExplicitZero;      // is this zero (encryptedData not allocated)
   std::vector<helib::Ctxt> encryptedData;
   char labelBuf[SHEINT_MAX_LABEL_SIZE];
+  mutable const char *labelPtr = nullptr; // label, labelBuf or nullptr
   // helper
   helib::Ctxt selectBit(const helib::Ctxt &trueBit,
                         const helib::Ctxt &falseBit) const;
@@ -132,7 +134,7 @@ private:
   {
     uint64_t current=nextTmp++;
     snprintf((char *)&labelBuf[0], sizeof(labelBuf), "t%d",current);
-    labelHash[this]=labelBuf;
+    labelPtr=labelBuf;
     return labelBuf;
   }
   void reCryptSextupleCounter(void) const {
@@ -173,7 +175,6 @@ protected:
 
 public:
    static constexpr std::string_view typeName = "SHEInt";
-  ~SHEInt(void) { labelHash.erase(this); }
   // empty constructor for SHEInt with minimal values and size;
   explicit SHEInt(const SHEPublicKey &pubkey) :
          pubKey(&pubkey), isUnsigned(true),
@@ -181,11 +182,18 @@ public:
   // basic constructor for custom SHEInt values;
   SHEInt(const SHEPublicKey &pubkey, uint64_t myInt,
          int bitSize, bool isUnsigned, const char *label=nullptr);
+  // constructor from already encrypted bits, least significant bit first
+  SHEInt(const SHEPublicKey &pubkey, const std::vector<helib::Ctxt> &bits,
+         bool isUnsigned_, const char *label=nullptr) :
+     pubKey(&pubkey), bitSize(bits.size()), isUnsigned(isUnsigned_),
+     isExplicitZero(bits.size() == 0), encryptedData(bits)
+  { if (label) { labelPtr = label; }
+    resetNative(); }
   // copy operators
   SHEInt(const SHEInt &a, const char *label) :
      pubKey(a.pubKey), isUnsigned(a.isUnsigned),
      bitSize(a.bitSize), isExplicitZero(a.isExplicitZero)
-  { if (label) { labelHash[this] = label; }
+  { if (label) { labelPtr = label; }
     if (!isExplicitZero) encryptedData = a.encryptedData; }
   SHEInt(const SHEInt &a) :
      pubKey(a.pubKey), isUnsigned(a.isUnsigned), bitSize(a.bitSize),
@@ -312,6 +320,17 @@ public:
   //template <T> T select(const T &a_true, const T &a_false) const {
   //  return select(*this, a_true, a_false);
   //}
+  // decode into 2^bitSize one hot bits, element i is an encrypted 1 if
+  // this == i and an encrypted 0 otherwise. Only practical for small ints.
+  std::vector<SHEInt> decode(void) const;
+  // bit manipulation builtins. The counts and the square root are returned
+  // in the same size and signedness as this.
+  SHEInt popcount(void) const;
+  SHEInt clz(void) const;
+  SHEInt ctz(void) const;
+  SHEInt parity(void) const;        // single bit
+  SHEInt bitReverse(void) const;
+  SHEInt isqrt(void) const;         // floor(sqrt(this)), 0 if negative
   // Accessor functions
   std::vector<helib::Ctxt> getCtxt(void) const {return encryptedData;}
   int getSize(void) const { return bitSize; }
@@ -360,7 +379,7 @@ public:
   }
   const char *getLabel(void) const
   {
-    const char *label = labelHash[this];
+    const char *label = labelPtr;
     if (label) return label;
     return setNextLabel();
   }
@@ -407,6 +426,11 @@ public:
   void reCrypt(SHEInt &a, SHEInt &b, SHEInt &c, SHEInt &d, bool force=false);
   void reCrypt(SHEInt &a, SHEInt &b, SHEInt &c, SHEInt &d, SHEInt &e,
                bool force=false);
+  // any number of values in one packed recrypt
+  static void verifyArgs(const std::vector<SHEInt *> &values,
+                         long level=SHEINT_DEFAULT_LEVEL_TRIGGER);
+  static void reCrypt(const std::vector<SHEInt *> &values, bool force=false);
+  // counts for the calling thread
   static SHERecryptCounters getRecryptCounters(void)
           { return recryptCounters; }
   static void resetRecryptCounters(void)  { recryptCounters = { 0 }; }
@@ -416,7 +440,11 @@ public:
     { debugPrivKey = &privKey; }
 #endif
   static void setLog(std::ostream &str) { log = &str; }
-  static size_t getBitSize(size_t len) { return log2i(len)+1; }
+  // per bit operations are spread across the NTL thread pool of the
+  // calling thread (which helib also uses), 0 is one thread per core
+  static void setThreads(int threads);
+  static int getThreads(void);
+  static size_t getBitSize(size_t len) { return len ? log2i(len)+1 : 1; }
 
   // input/output functions
   // use helib standard intput, outputs methods
@@ -478,6 +506,21 @@ inline SHEInt operator<<(uint64_t a, const SHEInt &b)
        { SHEInt heA(b, a); return heA<<b; }
 inline SHEInt operator>>(uint64_t a, const SHEInt &b)
        { SHEInt heA(b, a); return heA>>b; }
+// sum(a[i]*b[i]). All the partial products go into one carry save tree
+// with a single carry propagating add at the end, rather than a full
+// multiply and an add for each term. The result is the size of the largest
+// input and wraps like operator*.
+SHEInt dotProduct(const std::vector<SHEInt> &a, const std::vector<SHEInt> &b);
+SHEInt dotProduct(const std::vector<SHEInt> &a, const std::vector<int64_t> &b);
+// reductions over predicates, where any non-zero value is true. countTrue()
+// adds the predicate bits in one carry save tree, and is just wide enough
+// to hold the count. sumIf() masks each value with its predicate and adds
+// the masked bits in one tree, the result is the size of the largest value
+// and wraps like operator+. anyTrue() and allTrue() are OR and AND trees.
+SHEInt countTrue(const std::vector<SHEInt> &pred);
+SHEInt sumIf(const std::vector<SHEInt> &a, const std::vector<SHEInt> &pred);
+SHEInt anyTrue(const std::vector<SHEInt> &pred);
+SHEInt allTrue(const std::vector<SHEInt> &pred);
 inline  SHEInt select(const SHEInt &sel, const SHEInt &a_true,
                       const SHEInt &a_false)
        { return sel.select(a_true, a_false); }
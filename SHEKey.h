@@ -5,6 +5,8 @@
 #ifndef SHEkey_H
 #define SHEkey_H 1
 #include <iostream>
+#include <atomic>
+#include <mutex>
 #include <helib/helib.h>
 #include <helib/intraSlot.h>
 #include "SHEContext.h"
@@ -14,7 +16,8 @@ private:
   static std::ostream *log;
   bool empty;
   helib::PubKey *publicKey;
-  bool hasEncoding;
+  std::atomic<bool> hasEncoding;
+  mutable std::mutex encodingLock;     // building unpackSlotEncoding
   SHEContextType type;
   long contextSecurityLevel;
   long contextCapacity;
@@ -36,7 +39,7 @@ public:
     // Option 2 assume regenerating is expensive. We still have 'fast' copies
     // of publicKeys before we get an encoding, so it's probably the best
     // option.
-    hasEncoding = pubKey.hasEncoding;
+    hasEncoding = pubKey.hasEncoding.load(std::memory_order_acquire);
     if (hasEncoding) {
       unpackSlotEncoding = pubKey.unpackSlotEncoding;
     }
@@ -59,15 +62,20 @@ public:
   const helib::EncryptedArray &getEncryptedArray(void) const
         { return getHEContext().getEA(); }
   const std::vector<helib::zzX> *getUnpackSlotEncoding(void) const {
-        if (!hasEncoding) {
+        if (!hasEncoding.load(std::memory_order_acquire)) {
           // we are updating the cache, so we treat this as a logical
           // const (we aren't changing anything, we are just remembering
           // our calculated value for the future)
-          // cast away the consts to allow that to happen.
-          helib::buildUnpackSlotEncoding(
-                  (std::vector<helib::zzX> &)unpackSlotEncoding,
-                  getEncryptedArray());
-          *((bool *)&hasEncoding) = true;
+          // cast away the consts to allow that to happen. Only one
+          // thread builds it, the rest wait for it.
+          std::lock_guard<std::mutex> guard(encodingLock);
+          if (!hasEncoding.load(std::memory_order_relaxed)) {
+            helib::buildUnpackSlotEncoding(
+                    (std::vector<helib::zzX> &)unpackSlotEncoding,
+                    getEncryptedArray());
+            ((std::atomic<bool> &)hasEncoding).store(true,
+                                                 std::memory_order_release);
+          }
         }
         return &unpackSlotEncoding;
   }
@@ -69,6 +69,7 @@ make install-nodoc
 %{_bindir}/SHETest
 %{_bindir}/SHEMathTest
 %{_bindir}/SHEStringTest
+%{_bindir}/SHEPIRTest
 %{_bindir}/SHEPerf
 %{_bindir}/SHEEval
 %{_includedir}/SHELib
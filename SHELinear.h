@@ -0,0 +1,242 @@
+//
+// dot products and matrix multiplies on encrypted vectors
+//
+#ifndef SHELinear_H_
+#define SHELinear_H_ 1
+#include <cstdint>
+#include <vector>
+#include <type_traits>
+#include "SHEInt.h"
+#include "SHEFp.h"
+#include "SHEFixed.h"
+#include "SHEVector.h"
+
+//
+// Matrices are row major, a vector of rows. Each function has a version
+// where one side is plaintext, which is much cheaper: a plaintext integer
+// weight is only shifted copies of the encrypted bits.
+//
+// SHEInt (and subclasses) dot products put every partial product of every
+// term into one carry save tree and do a single carry propagating add at
+// the end (see dotProduct() in SHEInt.h). SHEFixed does the same on the
+// scaled integers at full product width, then shifts and saturates once.
+// SHEFp has to align and normalize each product, so it multiplies term by
+// term and sums the products in a pairwise tree to keep the depth at
+// log2(n) adds.
+//
+// T can be SHEInt and subclasses, SHEFixed, or SHEFp and subclasses. The
+// plaintext type P is int64_t (or anything that converts to it) for
+// SHEInt, and shemaxfloat_t for SHEFixed and SHEFp.
+//
+template<class T>
+using SHEMatrix = std::vector<SHEVector<T>>;
+template<class P>
+using SHEPlainMatrix = std::vector<std::vector<P>>;
+
+// sum the terms in a balanced tree
+template<class T>
+inline T sheTreeSum(std::vector<T> terms)
+{
+  helib::assertTrue(terms.size() > 0, "sum of an empty vector");
+  while (terms.size() > 1) {
+    std::vector<T> next;
+    for (int i=0; i+1 < terms.size(); i += 2) {
+      next.push_back(terms[i] + terms[i+1]);
+    }
+    if (terms.size() & 1) {
+      next.push_back(terms.back());
+    }
+    terms = next;
+  }
+  return terms[0];
+}
+
+template<class T>
+inline T dot(const SHEVector<T> &a, const SHEVector<T> &b)
+{
+  helib::assertTrue((a.size() == b.size()) && (a.size() > 0),
+                    "dot needs two non-empty vectors of one size");
+  T result(a[0]);
+  if constexpr (std::is_base_of<SHEInt, T>::value) {
+    result = dotProduct(std::vector<SHEInt>(a.begin(), a.end()),
+                        std::vector<SHEInt>(b.begin(), b.end()));
+  } else {
+    std::vector<T> terms;
+    for (int i=0; i < a.size(); i++) {
+      terms.push_back(a[i]*b[i]);
+    }
+    result = sheTreeSum(terms);
+  }
+  return result;
+}
+
+template<class T, class P>
+inline T dot(const SHEVector<T> &a, const std::vector<P> &b)
+{
+  helib::assertTrue((a.size() == b.size()) && (a.size() > 0),
+                    "dot needs two non-empty vectors of one size");
+  T result(a[0]);
+  if constexpr (std::is_base_of<SHEInt, T>::value) {
+    result = dotProduct(std::vector<SHEInt>(a.begin(), a.end()),
+                        std::vector<int64_t>(b.begin(), b.end()));
+  } else {
+    std::vector<T> terms;
+    for (int i=0; i < a.size(); i++) {
+      terms.push_back(a[i]*b[i]);
+    }
+    result = sheTreeSum(terms);
+  }
+  return result;
+}
+
+// fixed point, the products have 2*fracBits of fraction, so the sum is
+// formed wide enough to hold all of them and rescaled once
+template<int I, int F>
+inline int sheFixedDotSize(size_t n)
+{ return 2*(I+F) + SHEInt::getBitSize(n) + 1; }
+
+template<int I, int F>
+inline SHEFixed<I,F> sheFixedDotResult(const SHEFixed<I,F> &model,
+                                       SHEInt wide)
+{
+  SHEFixed<I,F> result(model);
+  wide >>= F;
+  result.setValueSaturate(wide);
+  return result;
+}
+
+template<int I, int F>
+inline SHEFixed<I,F> dot(const SHEVector<SHEFixed<I,F>> &a,
+                         const SHEVector<SHEFixed<I,F>> &b)
+{
+  helib::assertTrue((a.size() == b.size()) && (a.size() > 0),
+                    "dot needs two non-empty vectors of one size");
+  int size = sheFixedDotSize<I,F>(a.size());
+  std::vector<SHEInt> wideA, wideB;
+  for (int i=0; i < a.size(); i++) {
+    wideA.push_back(a[i].getValue());
+    wideA.back().reset(size, false);
+    wideB.push_back(b[i].getValue());
+    wideB.back().reset(size, false);
+  }
+  return sheFixedDotResult(a[0], dotProduct(wideA, wideB));
+}
+
+template<int I, int F, class P>
+inline SHEFixed<I,F> dot(const SHEVector<SHEFixed<I,F>> &a,
+                         const std::vector<P> &b)
+{
+  helib::assertTrue((a.size() == b.size()) && (a.size() > 0),
+                    "dot needs two non-empty vectors of one size");
+  int size = sheFixedDotSize<I,F>(a.size());
+  std::vector<SHEInt> wideA;
+  std::vector<int64_t> raw;
+  for (int i=0; i < a.size(); i++) {
+    wideA.push_back(a[i].getValue());
+    wideA.back().reset(size, false);
+    raw.push_back(SHEFixed<I,F>::toRaw(b[i]));
+  }
+  return sheFixedDotResult(a[0], dotProduct(wideA, raw));
+}
+
+// columns of a matrix, so matMul can take dot products
+template<class T>
+inline SHEMatrix<T> sheTranspose(const SHEMatrix<T> &m)
+{
+  helib::assertTrue((m.size() > 0) && (m[0].size() > 0),
+                    "empty matrix");
+  SHEMatrix<T> result;
+  for (int j=0; j < m[0].size(); j++) {
+    SHEVector<T> column(m[0][0], m.size());
+    for (int i=0; i < m.size(); i++) {
+      column[i] = m[i][j];
+    }
+    result.push_back(column);
+  }
+  return result;
+}
+
+template<class P>
+inline SHEPlainMatrix<P> sheTranspose(const SHEPlainMatrix<P> &m)
+{
+  helib::assertTrue((m.size() > 0) && (m[0].size() > 0),
+                    "empty matrix");
+  SHEPlainMatrix<P> result(m[0].size(), std::vector<P>(m.size()));
+  for (int i=0; i < m.size(); i++) {
+    for (int j=0; j < m[0].size(); j++) {
+      result[j][i] = m[i][j];
+    }
+  }
+  return result;
+}
+
+// m * x
+template<class T>
+inline SHEVector<T> matVec(const SHEMatrix<T> &m, const SHEVector<T> &x)
+{
+  helib::assertTrue(m.size() > 0, "empty matrix");
+  SHEVector<T> result(x[0], m.size());
+  for (int i=0; i < m.size(); i++) {
+    result[i] = dot(m[i], x);
+  }
+  return result;
+}
+
+template<class T, class P>
+inline SHEVector<T> matVec(const SHEPlainMatrix<P> &m, const SHEVector<T> &x)
+{
+  helib::assertTrue(m.size() > 0, "empty matrix");
+  SHEVector<T> result(x[0], m.size());
+  for (int i=0; i < m.size(); i++) {
+    result[i] = dot(x, m[i]);
+  }
+  return result;
+}
+
+// a * b
+template<class T>
+inline SHEMatrix<T> matMul(const SHEMatrix<T> &a, const SHEMatrix<T> &b)
+{
+  SHEMatrix<T> columns(sheTranspose(b));
+  SHEMatrix<T> result;
+  for (int i=0; i < a.size(); i++) {
+    SHEVector<T> row(a[i][0], columns.size());
+    for (int j=0; j < columns.size(); j++) {
+      row[j] = dot(a[i], columns[j]);
+    }
+    result.push_back(row);
+  }
+  return result;
+}
+
+template<class T, class P>
+inline SHEMatrix<T> matMul(const SHEPlainMatrix<P> &a, const SHEMatrix<T> &b)
+{
+  SHEMatrix<T> columns(sheTranspose(b));
+  SHEMatrix<T> result;
+  for (int i=0; i < a.size(); i++) {
+    SHEVector<T> row(b[0][0], columns.size());
+    for (int j=0; j < columns.size(); j++) {
+      row[j] = dot(columns[j], a[i]);
+    }
+    result.push_back(row);
+  }
+  return result;
+}
+
+template<class T, class P>
+inline SHEMatrix<T> matMul(const SHEMatrix<T> &a, const SHEPlainMatrix<P> &b)
+{
+  SHEPlainMatrix<P> columns(sheTranspose(b));
+  SHEMatrix<T> result;
+  for (int i=0; i < a.size(); i++) {
+    SHEVector<T> row(a[i][0], columns.size());
+    for (int j=0; j < columns.size(); j++) {
+      row[j] = dot(a[i], columns[j]);
+    }
+    result.push_back(row);
+  }
+  return result;
+}
+
+#endif
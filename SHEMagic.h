@@ -2,13 +2,14 @@
 // Magic numbers for binary serialization
 //
 #ifndef SHEMAGIC_H
-#define SHAMAGIC_H 1
+#define SHEMAGIC_H 1
 
 const long SHEPublicKeyMagic=0x0100;
 const long SHEPrivateKeyMagic=0x0101;
 const long SHEIntMagic=0x0e00;
 const long SHEFpMagic=0x0e01;
 const long SHEStringMagic=0x0e01;
+const long SHEFixedMagic=0x0e02;
 const long SHEVectorMagic=0x1000;
 
 #endif
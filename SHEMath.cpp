@@ -5,9 +5,11 @@
 #include "SHEFp.h"
 #include "SHEMath.h"
 #include "SHEVector.h"
+#include "SHEPolynomial.h"
 #include "math.h"
 
 #define SHE_ARRAY_SIZE(t) (sizeof(t)/sizeof(t[0]))
+#define SHEMATH_TABLE_SIZE (1 << SHEMATH_TABLE_BITS)
 
 static std::ostream *sheMathLog = nullptr;
 
@@ -16,6 +18,97 @@ void SHEMathSetLog(std::ostream &str)
    sheMathLog = &str;
 }
 
+// requested precision in bits for this thread, 0 is the full mantissa
+static thread_local int sheMathPrecision = 0;
+
+void SHEMathSetPrecision(int bits)
+{
+   sheMathPrecision = bits;
+}
+
+int SHEMathGetPrecision(void)
+{
+   return sheMathPrecision;
+}
+
+// polynomial kernels. The chebyshev fits are built once at
+// SHEMATH_TRIG_LOOP_COUNT degree over the range the callers reduce to,
+// then trimmed to the precision of the argument on each call. Odd and even
+// functions are fit in x^2 to halve the degree. sin, cos and exp only
+// need to cover one step of their reduction tables.
+static const shemaxfloat_t trigStep = M_PI_2/SHEMATH_TABLE_SIZE;
+static const shemaxfloat_t expStep = M_LN2/SHEMATH_TABLE_SIZE;
+static const SHEPolynomial cosPoly = SHEPolynomial::chebyshev(
+    [](shemaxfloat_t u) { return (shemaxfloat_t)std::cos(std::sqrt(u)); },
+    SHEMATH_TRIG_LOOP_COUNT/2, 0.0, trigStep*trigStep);
+static const SHEPolynomial sinPoly = SHEPolynomial::chebyshev(
+    [](shemaxfloat_t u) { return (shemaxfloat_t)(std::sin(std::sqrt(u))/
+                                                 std::sqrt(u)); },
+    SHEMATH_TRIG_LOOP_COUNT/2, 0.0, trigStep*trigStep);
+static const SHEPolynomial expPoly = SHEPolynomial::chebyshev(
+    [](shemaxfloat_t x) { return (shemaxfloat_t)std::exp(x); },
+    SHEMATH_TRIG_LOOP_COUNT/2, 0.0, expStep);
+// asin is only used up to 1/sqrt(2), atan up to 1.
+static const SHEPolynomial asinPoly = SHEPolynomial::chebyshev(
+    [](shemaxfloat_t u) { return (shemaxfloat_t)(std::asin(std::sqrt(u))/
+                                                 std::sqrt(u)); },
+    SHEMATH_TRIG_LOOP_COUNT, 0.0, 0.5);
+static const SHEPolynomial atanPoly = SHEPolynomial::chebyshev(
+    [](shemaxfloat_t u) { return (shemaxfloat_t)(std::atan(std::sqrt(u))/
+                                                 std::sqrt(u)); },
+    SHEMATH_TRIG_LOOP_COUNT, 0.0, 1.0);
+
+// reduction tables, f(i*step) for i in [0,SHEMATH_TABLE_SIZE)
+static std::vector<shemaxfloat_t>
+mkTable(const std::function<shemaxfloat_t(shemaxfloat_t)> &f,
+        shemaxfloat_t step)
+{
+  std::vector<shemaxfloat_t> table;
+  for (int i=0; i < SHEMATH_TABLE_SIZE; i++) {
+    table.push_back(f(i*step));
+  }
+  return table;
+}
+static std::vector<shemaxfloat_t> sinTable = mkTable(
+    [](shemaxfloat_t x) { return (shemaxfloat_t)std::sin(x); }, trigStep);
+static std::vector<shemaxfloat_t> cosTable = mkTable(
+    [](shemaxfloat_t x) { return (shemaxfloat_t)std::cos(x); }, trigStep);
+static std::vector<shemaxfloat_t> exp2Table = mkTable(
+    [](shemaxfloat_t x) { return (shemaxfloat_t)std::exp(x); }, expStep);
+
+// the error we can tolerate in a polynomial, half of the last mantissa bit
+// (or of the last requested bit)
+static shemaxfloat_t polyEpsilon(const SHEFp &a)
+{
+  return std::ldexp((shemaxfloat_t)1.0,
+                    -(SHEMathPrecisionBits(a.getMantissa().getSize())+1));
+}
+
+// taylor series with coefficients 1/(offset+step*i)!, stopping at
+// SHEMATH_TRIG_LOOP_COUNT or when the coefficient falls below what a
+// can represent, then trimmed for arguments up to xmax.
+static SHEPolynomial taylorPoly(const SHEFp &a, int offset, int step,
+                                shemaxfloat_t xmax)
+{
+  std::vector<shemaxfloat_t> coeff;
+  shemaxfloat_t minfloat = a.getMin();
+  shemaxfloat_t invFactorial = 1.0;
+  for (int i=2; i <= offset; i++) {
+    invFactorial /= (double)i;
+  }
+  for (int i=offset; i < SHEMATH_TRIG_LOOP_COUNT; i+=step) {
+    if (invFactorial == 0.0 || invFactorial < minfloat) {
+      break;
+    }
+    coeff.push_back(invFactorial);
+    for (int j=i+1; j <= i+step; j++) {
+      invFactorial /= (double)j;
+    }
+  }
+  return SHEPolynomial(coeff, SHEPolyMonomial, 0.0, xmax).
+                       trim(polyEpsilon(a));
+}
+
 // copy sign without costing  any capacity!
 SHEFp copysign(const SHEFp &a, const SHEFp &b)
 {
@@ -58,229 +151,138 @@ SHEFp fma(const SHEFp &a,  shemaxfloat_t b, shemaxfloat_t c) { return a*b + c; }
 SHEFp fma(shemaxfloat_t a, const SHEFp &b,  shemaxfloat_t c) { return a*b + c; }
 SHEFp fma(shemaxfloat_t a,  shemaxfloat_t b, const SHEFp &c) { return a*b + c; }
 
-// Trig functions use the power series.
-// reduce to a to a mod pi/2
-// q is the pi/2 quadrant from 0 to 2pi.
-static SHEFp trigReduce(const SHEFp &a, SHEInt &q)
+// a is in [0,trigStep)
+SHEFp sinb(const SHEFp &a)
 {
-  SHEInt sign = a.getSign();
-  SHEFp aabs(a.abs());
+  SHEPolynomial poly = sinPoly.trim(polyEpsilon(a));
+  SHEFp result = a*poly.evaluate(a*a);
   if (sheMathLog)
-    (*sheMathLog) << "trigReduce(" << (SHEFpSummary) a
-                  << ") sign= " << (SHEIntSummary) sign
-                  << ", a.abs()=" << (SHEFpSummary) aabs
-                  << std::endl;
-
-  SHEFp n=aabs;
-  n /= M_PI_2;
-  // we should pass a bitSize to toSHEInt based on our SHEFp size?
-  q=n.toSHEInt();
-  q.reset(2,true);
-  aabs = n.fract() * M_PI_2;
-  q = sign.select(3-q,q);
-  if (sheMathLog)
-   (*sheMathLog) << "  +aabs reset=" << (SHEFpSummary) aabs << " q="
-                 << (SHEIntSummary) q << std::endl;
-  return aabs;
+    (*sheMathLog) << "sin(" << (SHEFpSummary)a << ") = x*degree "
+                  << poly.getDegree() << " chebyshev in x^2, result="
+                  << (SHEFpSummary)result << std::endl;
+  return result;
 }
 
+// a is in [0,trigStep)
 SHEFp cosb(const SHEFp &a)
 {
-  SHEFp theta(a);
-  SHEFp result(theta,1.0);
-  SHEFp x(theta,1.0);
-  // use inverse factorial because it will give a definite
-  // ending for the loop as it approaches zero.
-  shemaxfloat_t invFactorial = 1.0;
-  shemaxfloat_t minfloat = a.getMin();
-  theta *= theta;
-  if (sheMathLog) {
-    (*sheMathLog) << "cos(" << (SHEFpSummary)a << ") = " << std::endl
-                  << " step 0 : x^0=" << (SHEFpSummary) x << " +"
-                  << invFactorial << "*x^0=" << (SHEFpSummary) x
-                  << " result=" <<(SHEFpSummary)result << std::endl;
-  }
-  for (int i=2; i < SHEMATH_TRIG_LOOP_COUNT; i+=2) {
-    // do the division unencrypted and them
-    // multiply
-    invFactorial /= (double)((i-1)*(i));
-    // once invFactorial goes to zero, we can't proceed further
-    if (invFactorial == 0.0 || invFactorial < minfloat) {
-      if (sheMathLog)
-        (*sheMathLog) << " step " << i << " : invFactorial=" << invFactorial
-                      << " < " << minfloat << std::endl;
-      break;
-    }
-    x *= theta;
-    SHEFp term = x*invFactorial;
-    if (sheMathLog)
-      (*sheMathLog) << " step " << i << " : x^" << i
-                    << "=" << (SHEFpSummary) x << " ";
-    if (i&2) {
-      result -= term;
-      if (sheMathLog) (*sheMathLog) << "-";
-    } else {
-      result += term;
-      if (sheMathLog) (*sheMathLog) << "+";
-    }
-    if (sheMathLog)
-      (*sheMathLog) << invFactorial
-                    << "*x^" << i << "=" << (SHEFpSummary)term
-                    << " result=" <<(SHEFpSummary)result << std::endl;
-  }
+  SHEPolynomial poly = cosPoly.trim(polyEpsilon(a));
+  SHEFp result = poly.evaluate(a*a);
+  if (sheMathLog)
+    (*sheMathLog) << "cos(" << (SHEFpSummary)a << ") = degree "
+                  << poly.getDegree() << " chebyshev in x^2, result="
+                  << (SHEFpSummary)result << std::endl;
   return result;
 }
 
-SHEFp coshb(const SHEFp &a)
+// table driven reduction for the circular functions. |a|/trigStep
+// splits into a remainder r in [0,trigStep), a table index k in the low
+// SHEMATH_TABLE_BITS of the integer part and the quadrant in the next two
+// bits. The kernels then only have to cover r:
+//   sin(k*trigStep+r) = S_k*cos(r) + C_k*sin(r)
+//   cos(k*trigStep+r) = C_k*cos(r) - S_k*sin(r)
+// s and c are the sin and cos of |a|, the caller fixes the sign.
+// Only the low bits of the integer part matter, but they have to be
+// exact, so we convert with enough bits to hold every integer the
+// mantissa can. Past that the integer is a multiple of 2^(bits+2),
+// which toSHEInt would saturate rather than give us the zero low bits.
+static void trigTableReduce(const SHEFp &a, SHEFp &s, SHEFp &c)
+{
+  SHEFp n(a.abs()*(1.0/trigStep));
+  int size = a.getMantissa().getSize() + SHEMATH_TABLE_BITS + 2;
+  SHEInt k(n.toSHEInt(size, true));
+  k = (n > (shemaxfloat_t)((1ULL << size)-1)).select(0, k);
+  SHEFp r(n.fract()*trigStep);
+  SHEInt q(k >> SHEMATH_TABLE_BITS);
+  q.reset(2,true);
+  k.reset(SHEMATH_TABLE_BITS,true);
+  if (sheMathLog)
+    (*sheMathLog) << "trigTableReduce(" << (SHEFpSummary) a
+                  << ") q=" << (SHEIntSummary) q
+                  << " k=" << (SHEIntSummary) k
+                  << " r=" << (SHEFpSummary) r << std::endl;
+  SHEFp sk(getVector(a,sinTable,k));
+  SHEFp ck(getVector(a,cosTable,k));
+  // sin(r) and cos(r) share the powers of r^2
+  shemaxfloat_t epsilon = polyEpsilon(a);
+  std::vector<SHEFp> kernel(SHEPolynomial::evaluate(
+        std::vector<SHEPolynomial>{sinPoly.trim(epsilon),
+                                   cosPoly.trim(epsilon)}, SHEFp(r*r)));
+  SHEFp sr(r*kernel[0]);
+  SHEFp cr(kernel[1]);
+  SHEFp sinTheta(sk*cr + ck*sr);
+  SHEFp cosTheta(ck*cr - sk*sr);
+  // now rotate by the quadrant
+  SHEFpBool q0(q.getBit(0));
+  SHEFpBool q1(q.getBit(1));
+  s = q0.select(cosTheta, sinTheta);
+  c = q0.select(sinTheta, cosTheta);
+  s = q1.select(-s, s);
+  c = SHEFpBool(q0 ^ q1).select(-c, c);
+}
+
+void sincos(const SHEFp &a, SHEFp &s, SHEFp &c)
+{
+  trigTableReduce(a,s,c);
+  s = SHEFpBool(a.getSign()).select(-s, s);
+}
+
+// below this sinh comes from its series, e^x-e^-x cancels
+static const shemaxfloat_t sinhSeriesMax = 0.5;
+
+SHEFp sinhb(const SHEFp &a)
 {
-  SHEFp theta(a);
-  SHEFp result(theta,1.0);
-  SHEFp x(theta,1.0);
-  // use inverse factorial because it will give a definite
-  // ending for the loop as it approaches zero.
-  shemaxfloat_t invFactorial = 1.0;
-  shemaxfloat_t minfloat = a.getMin();
-  theta *= theta;
-  if (sheMathLog) {
-    (*sheMathLog) << "cos(" << (SHEFpSummary)a << ") = " << std::endl
-                  << " step 0 : x^0=" << (SHEFpSummary) x << " +"
-                  << invFactorial << "*x^0=" << (SHEFpSummary) x
-                  << " result=" <<(SHEFpSummary)result << std::endl;
-  }
-  for (int i=2; i < SHEMATH_TRIG_LOOP_COUNT; i+=2) {
-    // do the division unencrypted and them
-    // multiply
-    invFactorial /= (double)((i-1)*(i));
-    // once invFactorial goes to zero, we can't proceed further
-    if (invFactorial == 0.0 || invFactorial < minfloat) {
-      if (sheMathLog)
-        (*sheMathLog) << " step " << i << " : invFactorial=" << invFactorial
-                      << " < " << minfloat << std::endl;
-      break;
-    }
-    x *= theta;
-    SHEFp term = x*invFactorial;
-    result += term;
-    if (sheMathLog)
-      (*sheMathLog) << " step " << i << " : x^" << i
-                    << "=" << (SHEFpSummary) x << " +"
-                    << invFactorial
-                    << "*x^" << i << "=" << (SHEFpSummary)term
-                    << " result=" <<(SHEFpSummary)result << std::endl;
-  }
+  // x*sum(x^2i/(2i+1)!)
+  SHEPolynomial poly = taylorPoly(a, 1, 2,
+                                  sinhSeriesMax*sinhSeriesMax);
+  SHEFp result = a*poly.evaluate(a*a);
+  if (sheMathLog)
+    (*sheMathLog) << "sinh(" << (SHEFpSummary)a << ") = x*degree "
+                  << poly.getDegree() << " taylor in x^2, result="
+                  << (SHEFpSummary)result << std::endl;
   return result;
 }
 
-SHEFp cos(const SHEFp &a)
+// sinh(|a|) and cosh(|a|), the caller fixes the sign of sinh. Both come
+// from e=e^|a| and one divide for e^-|a|, except sinh for small |a|.
+static void hyperbolicReduce(const SHEFp &a, SHEFp &e, SHEFp &einv,
+                             SHEFp &sh, SHEFp &ch)
 {
-  SHEInt q(a.getSign(), (uint64_t)0);
-  SHEFp theta = trigReduce(a,q);
-  SHEFpBool rev(q);
-  rev.reset(1,true);
-  theta = rev.select(M_PI_2-theta,theta);
-  SHEFp result = cosb(theta);
-  q = q.getBitHigh(0) ^ q.getBitHigh(1);
-  result = SHEFpBool(q).select(-result,result);
-  return result;
+  SHEFp aabs(a.abs());
+  e = exp(aabs);
+  einv = 1.0/e;
+  ch = ldexp(e + einv, (int64_t)-1);
+  sh = ldexp(e - einv, (int64_t)-1);
+  sh = select(aabs < sinhSeriesMax, sinhb(aabs), sh);
+  if (sheMathLog)
+    (*sheMathLog) << "hyperbolicReduce(" << (SHEFpSummary) a
+                  << ") e=" << (SHEFpSummary) e
+                  << " sinh=" << (SHEFpSummary) sh
+                  << " cosh=" << (SHEFpSummary) ch << std::endl;
 }
 
-SHEFp acos(const SHEFp &a)
-  { return M_PI_2-asin(a); }
-
-SHEFp cosh(const SHEFp &a)
+void sinhcosh(const SHEFp &a, SHEFp &sh, SHEFp &ch)
 {
-  SHEInt q(a.getSign(), (uint64_t)0);
-  SHEFp theta = trigReduce(a,q);
-  SHEFpBool rev(q);
-  rev.reset(1,true);
-  theta = rev.select(M_PI_2-theta,theta);
-  SHEFp result = coshb(theta);
-  q = q.getBitHigh(0) ^ q.getBitHigh(1);
-  result = SHEFpBool(q).select(-result,result);
-  return result;
+  SHEFp e(a), einv(a);
+  hyperbolicReduce(a,e,einv,sh,ch);
+  sh = SHEFpBool(a.getSign()).select(-sh, sh);
 }
 
-SHEFp sinb(const SHEFp &a)
+SHEFp cos(const SHEFp &a)
 {
-  SHEFp theta(a);
-  SHEFp result(theta,1.0);
-  SHEFp x(theta);
-  shemaxfloat_t invFactorial = 1.0;
-  shemaxfloat_t minfloat = a.getMin();
-  result = x;
-  if (sheMathLog)
-    (*sheMathLog) << "sin(" << (SHEFpSummary)a << ") = " << std::endl
-                  << " step 1 : x=" << (SHEFpSummary) x << " +"
-                  << invFactorial << "*x=" << (SHEFpSummary) x
-                  << " result=" <<(SHEFpSummary)result << std::endl;
-  theta *= theta;
-  for (int i=3; i < SHEMATH_TRIG_LOOP_COUNT; i+=2) {
-    // do the division unencrypted and them
-    // multiply
-    invFactorial /= (double)((i-1)*(i));
-    // once invFactorial goes to zero, we can't proceed further
-    if (invFactorial == 0.0 || invFactorial < minfloat) {
-      if (sheMathLog)
-        (*sheMathLog) << " step " << i << " : invFactorial=" << invFactorial
-                      << " < " << minfloat << std::endl;
-      break;
-    }
-    x *= theta;
-    SHEFp term = invFactorial*x;
-    if (sheMathLog)
-      (*sheMathLog) << " step " << i << " : x^" << i
-                    << "=" << (SHEFpSummary) x << " ";
-    if (i&2) {
-      result -= term;
-      if (sheMathLog) (*sheMathLog) << "-";
-    } else {
-      result += term;
-      if (sheMathLog) (*sheMathLog) << "+";
-    }
-    if (sheMathLog)
-      (*sheMathLog) << invFactorial
-                    << "*x^" << i << "=" << (SHEFpSummary)term
-                    << " result=" <<(SHEFpSummary)result << std::endl;
-  }
-  return result;
+  SHEFp s(a), c(a);
+  trigTableReduce(a,s,c);
+  return c;
 }
 
-SHEFp sinhb(const SHEFp &a)
+SHEFp acos(const SHEFp &a)
+  { return M_PI_2-asin(a); }
+
+SHEFp cosh(const SHEFp &a)
 {
-  SHEFp theta(a);
-  SHEFp result(theta,1.0);
-  SHEFp x(theta);
-  shemaxfloat_t invFactorial = 1.0;
-  shemaxfloat_t minfloat = a.getMin();
-  result = x;
-  if (sheMathLog)
-    (*sheMathLog) << "sinh(" << (SHEFpSummary)a << ") = " << std::endl
-                  << " step 1 : x=" << (SHEFpSummary) x << " +"
-                  << invFactorial << "*x=" << (SHEFpSummary) x
-                  << " result=" <<(SHEFpSummary)result << std::endl;
-  theta *= theta;
-  for (int i=3; i < SHEMATH_TRIG_LOOP_COUNT; i+=2) {
-    // do the division unencrypted and them
-    // multiply
-    invFactorial /= (double)((i-1)*(i));
-    // once invFactorial goes to zero, we can't proceed further
-    if (invFactorial == 0.0 || invFactorial < minfloat) {
-      if (sheMathLog)
-        (*sheMathLog) << " step " << i << " : invFactorial=" << invFactorial
-                      << " < " << minfloat << std::endl;
-      break;
-    }
-    x *= theta;
-    SHEFp term = invFactorial*x;
-    result += term;
-    if (sheMathLog)
-      (*sheMathLog) << " step " << i << " : x^" << i
-                    << "=" << (SHEFpSummary) x << " +"
-                    << invFactorial
-                    << "*x^" << i << "=" << (SHEFpSummary)term
-                    << " result=" <<(SHEFpSummary)result << std::endl;
-  }
-  return result;
+  SHEFp sh(a), ch(a);
+  sinhcosh(a,sh,ch);
+  return ch;
 }
 
 SHEFp asinhb(const SHEFp &a) {
@@ -345,59 +347,18 @@ SHEFp asinhb(const SHEFp &a) {
 
 SHEFp sin(const SHEFp &a)
 {
-  // q is the quadrant.
-  SHEInt q(a.getSign(), (uint64_t)0);
-  SHEFp theta = trigReduce(a,q);
-  SHEFpBool rev(q);
-  rev.reset(1,true);
-  theta = rev.select(M_PI_2-theta,theta);
-  SHEFp result = sinb(theta);
-  // switch(q)
-  result = SHEFpBool(q.getBitHigh(0)).select(-result, result);
-  return result;
+  SHEFp s(a), c(a);
+  trigTableReduce(a,s,c);
+  return SHEFpBool(a.getSign()).select(-s, s);
 }
 
 SHEFp asinb(const SHEFp &a) {
-  SHEFp theta(a);
-  SHEFp result(theta,1.0);
-  SHEFp x(theta);
-  shemaxfloat_t coefficient = 1.0;
-  shemaxfloat_t terminate = .9;  // when to terminate the loop
-  shemaxfloat_t minfloat = a.getMin();
-  result = x;
+  SHEPolynomial poly = asinPoly.trim(polyEpsilon(a));
+  SHEFp result = a*poly.evaluate(a*a);
   if (sheMathLog)
-    (*sheMathLog) << "asin(" << (SHEFpSummary)a << ") =" << std::endl
-                  << " step 1 : x=" << (SHEFpSummary) x << " +"
-                  << coefficient << "*x=" << (SHEFpSummary) x
-                  << " result=" <<(SHEFpSummary)result << std::endl;
-  theta *= theta;
-  for (int i=3; i < SHEMATH_ARC_LOOP_COUNT; i+=2) {
-    // do the division unencrypted and them
-    // multiply
-    coefficient *= (double)(i-2)/(double)(i-1);
-    double fcoefficient = coefficient/(double)i;
-    // this detects when it is no longer possible to add more
-    // results based on the floating point percision for normal
-    // valid inputs.
-    terminate  *= (double)(i-2)/(double)(i-1);
-    terminate *= .81;
-    // once coefficient goes to zero, we can't proceed further
-    if (terminate == 0.0 || terminate < minfloat) {
-      if (sheMathLog)
-        (*sheMathLog) << " step " << i << " : term=" << terminate
-                      << " < " << minfloat << std::endl;
-      break;
-    }
-    x *= theta;
-    SHEFp term = fcoefficient*x;
-    result += term;
-    if (sheMathLog)
-      (*sheMathLog) << " step " << i << " : x^" << i
-                    << "=" << (SHEFpSummary) x << " +"
-                    << fcoefficient
-                    << "*x^" << i << "=" << (SHEFpSummary)term
-                    << " result=" <<(SHEFpSummary)result << std::endl;
-  }
+    (*sheMathLog) << "asin(" << (SHEFpSummary)a << ") = x*degree "
+                  << poly.getDegree() << " chebyshev in x^2, result="
+                  << (SHEFpSummary)result << std::endl;
   return result;
 }
 
@@ -414,177 +375,31 @@ SHEFp asin(const SHEFp &a)
   return result;
 }
 
-SHEFp sinh(const SHEFp &a) {
-  // q is the quadrant.
-  SHEInt q(a.getSign(), (uint64_t)0);
-  SHEFp theta = trigReduce(a,q);
-  SHEFpBool rev(q);
-  rev.reset(1,true);
-  theta = rev.select(M_PI_2-theta,theta);
-  SHEFp result = sinhb(theta);
-  // switch(q)
-  result = SHEFpBool(q.getBitHigh(0)).select(-result, result);
-  return result;
-}
-
-
-
-// tan and tanh need these magic constants hopefully 17777777 of them is enough
-shemaxfloat_t taylor_tan[] = {
-#ifdef SHEFP_USE_DOUBLE
-  +1.00000000000000E+00, +3.33333333333333E-01,
-  +1.33333333333333E-01, +5.39682539682540E-02,
-  +2.18694885361552E-02, +8.86323552990220E-03,
-  +3.59212803657248E-03, +1.45583433917050E-03,
-  +5.90027463286219E-04, +2.39129100628593E-04,
-  +9.69153838863717E-05, +3.92783258380507E-05,
-  +1.59189050485676E-05, +6.45168929248486E-06,
-  +2.61477121671397E-06, +1.05972685053282E-06,
-  +4.29491095269173E-07
-#else
-  +1.00000000000000000000000000000E+00, +3.33333333333333333342368351437E-01,
-  +1.33333333333333333339657846006E-01, +5.39682539682539682545921004564E-02,
-  +2.18694885361552028211589967024E-02, +8.86323552990219656898713022561E-03,
-  +3.59212803657248101694694601693E-03, +1.45583433917049656577375702513E-03,
-  +5.90027463286218677914110174610E-04, +2.39129100628592788514526631884E-04,
-  +9.69153838863716870502102676988E-05, +3.92783258380506872029330339973E-05,
-  +1.59189050485676058423009938597E-05, +6.45168929248486274756231032580E-06,
-  +2.61477121671397178921995365722E-06, +1.05972685053282340400410922393E-06,
-  +4.29491095269172544223167813564E-07
-#endif
-};
-
-SHEFp tanb(const SHEFp &a)
+SHEFp sinh(const SHEFp &a)
 {
-  SHEFp theta(a);
-  SHEFp result(theta);
-  SHEFp x(theta);
-  shemaxfloat_t minfloat = a.getMin();
-  result = theta;
-  theta *= theta;
-  if (sheMathLog)
-    (*sheMathLog) << "tan(" << (SHEFpSummary) a << ")=" << std::endl
-                  << " step 1 : x"
-                  << "=" << (SHEFpSummary) x << " "
-                  << taylor_tan[0]
-                  << "*" << "*x = " << (SHEFpSummary) x
-                  << " result=" <<(SHEFpSummary)result << std::endl;
-  for (int i=3; i < SHEMATH_TRIG_LOOP_COUNT; i+=2) {
-    helib::assertTrue(i/2 < SHE_ARRAY_SIZE(taylor_tan),
-                      "tangent taylor series table overflow");
-    // grab the fully calculated taylor series coefficent
-    shemaxfloat_t taylor = taylor_tan[i/2];
-    if (taylor == 0.0 || taylor < minfloat) {
-      if (sheMathLog)
-        (*sheMathLog) << " step " << i << " : taylor=" << taylor
-                      << " < " << minfloat << std::endl;
-      break;
-    }
-    x *= theta;
-    SHEFp term = x*taylor;
-    result += term;
-    if (sheMathLog)
-      (*sheMathLog) << " step " << i << " : x^" << i
-                    << "=" << (SHEFpSummary) x << " "
-                    << taylor << "**x^" << i << "=" << (SHEFpSummary) term
-                    << " result=" <<(SHEFpSummary)result << std::endl;
-  }
-  return result;
-}
-
-SHEFp tanhb(const SHEFp &a)
-{
-  SHEFp theta(a);
-  SHEFp result(theta);
-  SHEFp x(theta);
-  shemaxfloat_t minfloat = a.getMin();
-  result = theta;
-  theta *= theta;
-  if (sheMathLog)
-    (*sheMathLog) << "tan(" << (SHEFpSummary) a << ")=" << std::endl
-                  << " step 1 : x"
-                  << "=" << (SHEFpSummary) x << " "
-                  << taylor_tan[0]
-                  << "*" << "*x = " << (SHEFpSummary) x
-                  << " result=" <<(SHEFpSummary)result << std::endl;
-  for (int i=3; i < SHEMATH_TRIG_LOOP_COUNT; i+=2) {
-    helib::assertTrue(i/2 < SHE_ARRAY_SIZE(taylor_tan),
-                      "tangent taylor series table overflow");
-    // grab the fully calculated taylor series coefficent
-    shemaxfloat_t taylor = taylor_tan[i/2];
-    if (taylor == 0.0 || taylor < minfloat) {
-      if (sheMathLog)
-        (*sheMathLog) << " step " << i << " : taylor=" << taylor
-                      << " < " << minfloat << std::endl;
-      break;
-    }
-    x *= theta;
-    SHEFp term = x*taylor;
-    if (sheMathLog)
-      (*sheMathLog) << " step " << i << " : x^" << i
-                    << "=" << (SHEFpSummary) x << " ";
-    if (i&2) {
-      result -= term;
-      if (sheMathLog) (*sheMathLog) << "-";
-    } else {
-      result += term;
-      if (sheMathLog) (*sheMathLog) << "+";
-    }
-    if (sheMathLog)
-      (*sheMathLog) << taylor
-                    << "*x^" << i << "=" << (SHEFpSummary)term
-                    << " result=" <<(SHEFpSummary)result << std::endl;
-  }
-  return result;
+  SHEFp sh(a), ch(a);
+  sinhcosh(a,sh,ch);
+  return sh;
 }
 
 SHEFp atanb(const SHEFp &a)
 {
-  SHEFp theta(a);
-  SHEFp result(theta,1.0);
-  SHEFp x(theta);
-  result = x;
+  SHEPolynomial poly = atanPoly.trim(polyEpsilon(a));
+  SHEFp result = a*poly.evaluate(a*a);
   if (sheMathLog)
-    (*sheMathLog) << "atan(" << (SHEFpSummary)a << ") = " << std::endl
-                  << " step 1 : x=" << (SHEFpSummary) x << "+x="
-                  << (SHEFpSummary) x << " result=" <<(SHEFpSummary)result
-                  << std::endl;
-  theta *= theta;
-  for (int i=3; i < SHEMATH_TRIG_LOOP_COUNT; i+=2) {
-    // do the division unencrypted and them
-    // multiply
-    double coefficient = 1.0/(double)(i);
-    x *= theta;
-    SHEFp term = coefficient*x;
-    if (sheMathLog)
-      (*sheMathLog) << " step " << i << " : x^" << i
-                    << "=" << (SHEFpSummary) x << " ";
-    if (i&2) {
-      result -= term;
-      if (sheMathLog) (*sheMathLog) << "-";
-    } else {
-      result += term;
-      if (sheMathLog) (*sheMathLog) << "+";
-    }
-    if (sheMathLog)
-      (*sheMathLog) << coefficient
-                    << "*x^" << i << "=" << (SHEFpSummary)term
-                    << " result=" <<(SHEFpSummary)result << std::endl;
-  }
+    (*sheMathLog) << "atan(" << (SHEFpSummary)a << ") = x*degree "
+                  << poly.getDegree() << " chebyshev in x^2, result="
+                  << (SHEFpSummary)result << std::endl;
   return result;
 }
 
+// one divide is cheaper than the tan taylor series, which also
+// converges badly near pi/2
 SHEFp tan(const SHEFp &a)
 {
-  // q is the quadrant.
-  SHEInt q(a.getSign(), (uint64_t)0);
-  SHEFp theta = trigReduce(a,q);
-  SHEFpBool rev(q);
-  rev.reset(1,true);
-  theta = rev.select(M_PI_2-theta,theta);
-  SHEFp result = tanb(theta);
-  result = rev.select(-result, result);
-  return result;
+  SHEFp s(a), c(a);
+  sincos(a,s,c);
+  return s/c;
 }
 
 SHEFp atan(const SHEFp &a)
@@ -645,17 +460,19 @@ SHEFp atan2(const SHEFp &a, const SHEFp &b)
   return result;
 }
 
+// tanh is 1 to the last mantissa bit once e^-2|a| drops below it, and
+// sinh/cosh would overflow to inf/inf there.
+static SHEFp tanhFinish(const SHEFp &a, const SHEFp &sh, const SHEFp &ch)
+{
+  shemaxfloat_t saturate = (a.getMantissa().getSize()+2)*M_LN2/2.0;
+  return select(a.abs() > saturate, copysign(1.0,a), sh/ch);
+}
+
 SHEFp tanh(const SHEFp &a)
 {
-  // q is the quadrant.
-  SHEInt q(a.getSign(), (uint64_t)0);
-  SHEFp theta = trigReduce(a,q);
-  SHEFpBool rev(q);
-  rev.reset(1,true);
-  theta = rev.select(M_PI_2-theta,theta);
-  SHEFp result = tanhb(theta);
-  result = rev.select(-result, result);
-  return result;
+  SHEFp sh(a), ch(a);
+  sinhcosh(a,sh,ch);
+  return tanhFinish(a,sh,ch);
 }
 
 // last of the hyperbolic trig functions, use their
@@ -664,52 +481,82 @@ SHEFp acosh(const SHEFp &a) { return log(a+sqrt(a*a-1.0)); }
 SHEFp asinh(const SHEFp &a) { return log(a+sqrt(a*a+1.0)); }
 SHEFp atanh(const SHEFp &a) { return .5*log((a+1.0)/(1.0-a)); }
 
-// Power and logs....
-// exp with a power series
-SHEFp exp(const SHEFp &a)
+// SHEMathShared, each family is reduced on first use
+void SHEMathShared::reduceTrig(void)
 {
-  SHEFp result(a,1.0);
-  SHEFp x(a);
-  shemaxfloat_t invFactorial = 1.0;
-  shemaxfloat_t minfloat = a.getMin();
-  if (sheMathLog)
-    (*sheMathLog) << "exp(" << (SHEFpSummary) a << ")=" << std::endl
-                  << " step 0 : x^0=" << (SHEFpSummary) result << " 1.0*x^0="
-                  << (SHEFpSummary) result << " result="
-                  << (SHEFpSummary) result << std::endl;
-  result += x;
-  if (sheMathLog)
-    (*sheMathLog) << " step 1 : x=" << (SHEFpSummary)x << " "
-                  << invFactorial << "*x=" << (SHEFpSummary)x
-                  << " result=" <<(SHEFpSummary)result << std::endl;
-  for (int i=2; i < SHEMATH_TRIG_LOOP_COUNT; i++) {
-    // do the division unencrypted and them
-    // multiply
-    invFactorial /= (double)i;
-    // once invFactorial goes to zero, the caclulation can't
-    // proceed further
-    if (invFactorial == 0.0 || invFactorial < minfloat) {
-      if (sheMathLog)
-        (*sheMathLog) << " step " << i << " : invFactorial=" << invFactorial
-                      << " < " << minfloat << std::endl;
-      break;
-    }
-    x *= a;
-    SHEFp term=x*invFactorial;
-    result += term;
-    if (sheMathLog)
-      (*sheMathLog) << " step " << i << " : x^" << i
-                    << "=" << (SHEFpSummary) x << " "
-                    << invFactorial
-                    << "*x^" << i << "=" << (SHEFpSummary) term
-                    << " result=" <<(SHEFpSummary)result << std::endl;
+  if (haveTrig) {
+    return;
   }
-  return result;
+  sincos(arg,sinValue,cosValue);
+  haveTrig = true;
 }
 
+void SHEMathShared::reduceHyperbolic(void)
+{
+  if (haveHyperbolic) {
+    return;
+  }
+  hyperbolicReduce(arg,expValue,expInvValue,sinhValue,coshValue);
+  sinhValue = SHEFpBool(arg.getSign()).select(-sinhValue, sinhValue);
+  haveHyperbolic = true;
+}
+
+SHEFp SHEMathShared::sin(void) { reduceTrig(); return sinValue; }
+SHEFp SHEMathShared::cos(void) { reduceTrig(); return cosValue; }
+SHEFp SHEMathShared::tan(void) { reduceTrig(); return sinValue/cosValue; }
+SHEFp SHEMathShared::sinh(void) { reduceHyperbolic(); return sinhValue; }
+SHEFp SHEMathShared::cosh(void) { reduceHyperbolic(); return coshValue; }
+SHEFp SHEMathShared::tanh(void)
+{
+  reduceHyperbolic();
+  return tanhFinish(arg,sinhValue,coshValue);
+}
+// e^a is e^|a| or its inverse, both of which we already have
+SHEFp SHEMathShared::exp(void)
+{
+  reduceHyperbolic();
+  return select(arg.getSign(), expInvValue, expValue);
+}
+
+// Power and logs....
+// exp2 with table driven reduction. a*SHEMATH_TABLE_SIZE splits into
+// an integer n and a fraction. The low SHEMATH_TABLE_BITS of n pick
+// 2^(k/SHEMATH_TABLE_SIZE) from a table, the rest of n is added to the
+// exponent and the polynomial only covers e^r for r in [0,expStep).
+// Any n past +/-(2*bias+mantissa) overflows or underflows, so we clamp
+// y there and n then fits a signed int a few bits wider than the
+// exponent (toSHEInt saturates, which would wrap in a signed int).
 SHEFp exp2(const SHEFp &a)
 {
-  return exp(a*M_LN2);
+  int expSize = a.getExp().getSize();
+  int mantissaSize = a.getMantissa().getSize();
+  int size = std::max(expSize + SHEMATH_TABLE_BITS + 2, mantissaSize);
+  shemaxfloat_t limit = (shemaxfloat_t) ((((1ULL << (expSize-1))-1)*2 +
+                                          mantissaSize) * SHEMATH_TABLE_SIZE);
+  SHEFp y(a*(shemaxfloat_t)SHEMATH_TABLE_SIZE);
+  y = select(y > limit, limit, y);
+  y = select(y < -limit, -limit, y);
+  SHEFp n(floor(y));
+  SHEFp r((y-n)*expStep);
+  SHEInt k(n.toSHEInt(size));
+  SHEInt e(k >> SHEMATH_TABLE_BITS);
+  k.reset(SHEMATH_TABLE_BITS,true);
+  SHEPolynomial poly = expPoly.trim(polyEpsilon(a));
+  SHEFp result(getVector(a,exp2Table,k)*poly.evaluate(r));
+  if (sheMathLog)
+    (*sheMathLog) << "exp2(" << (SHEFpSummary) a << ") e="
+                  << (SHEIntSummary) e << " k=" << (SHEIntSummary) k
+                  << " r=" << (SHEFpSummary) r << " degree "
+                  << poly.getDegree() << " chebyshev, result="
+                  << (SHEFpSummary)result << std::endl;
+  // scalbn handles the overflow to infinity and underflow to zero
+  result = scalbn(result, e);
+  return select(a.isNan(), NAN, result);
+}
+
+SHEFp exp(const SHEFp &a)
+{
+  return exp2(a*M_LOG2E);
 }
 
 // a is small and close to zero
@@ -991,6 +838,25 @@ SHEFp pow(const SHEFp &a, shemaxfloat_t b)
   if (b == 0.0) {
     return SHEFp(a,1.0);
   }
+  // integer exponents don't need log and exp. The exponent bits are
+  // plaintext, so only the squarings and the set bits cost multiplies.
+  if ((b == std::floor(b)) &&
+      (shemaxfloat_abs(b) < (shemaxfloat_t)(1ULL << 32))) {
+    uint64_t n = (uint64_t)shemaxfloat_abs(b);
+    SHEFp power(a);
+    SHEFp result(a,1.0);
+    bool first = true;
+    for (; n; n >>= 1) {
+      if (n & 1) {
+        result = first ? power : result*power;
+        first = false;
+      }
+      if (n > 1) {
+        power *= power;
+      }
+    }
+    return (b < 0.0) ? 1.0/result : result;
+  }
   bool odd=((uint64_t)b)&1;
   // I could do a lot of manipulation of b to get it's
   // evenness status, but it's easier just to let the system
@@ -1005,59 +871,294 @@ SHEFp pow(const SHEFp &a, shemaxfloat_t b)
   return result;
 }
 
-// there is definately faster ways of doing sqrt,
-// use Newton's to calculate sqrt
-SHEFp sqrt(const SHEFp &a)
+// Encrypted integer exponents, by square and multiply over the exponent
+// bits. Each bit costs a squaring and a multiply by select(bit,power,1),
+// so the cost depends on the size of the exponent, not its value. The
+// running power and result are bootstrapped together at the top of each
+// round, with enough capacity for both multiplies, rather than each
+// multiply stopping to recrypt its own operands.
+#define SHEMATH_POW_LEVEL (SHEINT_DEFAULT_LEVEL_TRIGGER*2)
+
+// |b| as an unsigned value
+static SHEInt powExponent(const SHEInt &b)
 {
-  SHEFp y(a);
-  SHEFp x(a);
-  SHEInt exp(a.getExp());
-  SHEFp man = frexp(a,exp);
-  exp.reset(exp.getSize(), false);
-  exp = exp >> 1;
-  man *= 2;
-  y=ldexp(man,exp);
-  x *= .5;
+  SHEInt n(b.abs());
+  n.reset(n.getSize(),true);
+  return n;
+}
+
+// integer pow wraps like integer multiply. Negative exponents truncate
+// 1/a^|b| toward zero, so only a=1 and a=-1 give a non-zero result.
+SHEInt pow(const SHEInt &a, const SHEInt &b)
+{
+  SHEInt n(powExponent(b));
+  SHEInt power(a);
+  SHEInt result(a,(uint64_t)1);
+  for (int i=0; i < n.getSize(); i++) {
+    result.verifyArgs(power, SHEMATH_POW_LEVEL);
+    result *= n.getBit(i).select(power,(uint64_t)1);
+    if (i+1 < n.getSize()) {
+      power *= power;
+    }
+  }
+  if (b.getUnsigned()) {
+    return result;
+  }
+  SHEInt unit(a.abs() == (uint64_t)1);
+  return (b.isNegative() && !unit).select((uint64_t)0,result);
+}
+
+SHEFp pow(const SHEFp &a, const SHEInt &b)
+{
+  SHEInt n(powExponent(b));
+  SHEFp power(a);
+  SHEFp result(a,1.0);
+  for (int i=0; i < n.getSize(); i++) {
+    result.verifyArgs(power, SHEMATH_POW_LEVEL);
+    result *= SHEFpBool(n.getBit(i)).select(power,1.0);
+    if (i+1 < n.getSize()) {
+      power *= power;
+    }
+  }
+  if (b.getUnsigned()) {
+    return result;
+  }
+  return SHEFpBool(b.isNegative()).select(1.0/result, result);
+}
+
+// a^b mod m. The products are formed at twice the width of the modulus so
+// they can't wrap before they are reduced. a and m are taken as unsigned
+// and b as |b|.
+static SHEInt modpowRaw(const SHEInt &a, const SHEInt &b, int size,
+                        const std::function<SHEInt(const SHEInt &)> &reduce)
+{
+  SHEInt n(powExponent(b));
+  SHEInt power(a);
+  power.reset(size,true);
+  power.reset(size*2,true);
+  power = reduce(power);
+  SHEInt result(power,(uint64_t)1);
+  for (int i=0; i < n.getSize(); i++) {
+    result.verifyArgs(power, SHEMATH_POW_LEVEL);
+    result = reduce(result*n.getBit(i).select(power,(uint64_t)1));
+    if (i+1 < n.getSize()) {
+      power = reduce(power*power);
+    }
+  }
+  result.reset(size,true);
+  return result;
+}
+
+SHEInt modpow(const SHEInt &a, const SHEInt &b, const SHEInt &m)
+{
+  int size = std::max(a.getSize(), m.getSize());
+  SHEInt mod(m);
+  mod.reset(m.getSize(),true);
+  mod.reset(size*2,true);
+  return modpowRaw(a, b, size,
+                   [&mod](const SHEInt &x) { return x % mod; });
+}
+
+SHEInt modpow(const SHEInt &a, const SHEInt &b, uint64_t m)
+{
+  if (m == 0) {
+    throw helib::LogicError("modpow by zero");
+  }
+  int size = 1;
+  while ((size < 64) && (m >> size)) {
+    size++;
+  }
+  size = std::max(a.getSize(), size);
+  return modpowRaw(a, b, size,
+                   [m](const SHEInt &x) { return x % m; });
+}
+
+// seed tables for the newton iterations in sqrt, rsqrt and cbrt.
+// a = m*2^e with m in [0.5,1). e is split into e'+r, where e' is a
+// multiple of the root (2 or 3), and the iteration runs on x=m*2^r. The
+// table index is r followed by the top SHEMATH_TABLE_BITS of m after the
+// leading one. Each entry is a line fitted to f over its interval, so one
+// lookup and one multiply gives about 2*SHEMATH_TABLE_BITS+4 good bits.
+struct SHEMathSeedTable {
+  std::vector<shemaxfloat_t> intercept;
+  std::vector<shemaxfloat_t> slope;
+  int precision;
+};
+
+static SHEMathSeedTable
+mkSeedTable(const std::function<shemaxfloat_t(shemaxfloat_t)> &f, int root)
+{
+  SHEMathSeedTable table;
+  shemaxfloat_t step = std::ldexp((shemaxfloat_t)1.0,-(SHEMATH_TABLE_BITS+1));
+  shemaxfloat_t worst = 0.0;
+  for (int r=0; r < root; r++) {
+    for (int i=0; i < SHEMATH_TABLE_SIZE; i++) {
+      shemaxfloat_t lo = std::ldexp(0.5+i*step, r);
+      shemaxfloat_t hi = std::ldexp(0.5+(i+1)*step, r);
+      shemaxfloat_t slope = (f(hi)-f(lo))/(hi-lo);
+      shemaxfloat_t intercept = f(lo)-slope*lo;
+      // f is convex, so the chord is above it, split the difference
+      shemaxfloat_t gap = 0.0;
+      for (int k=0; k <= 64; k++) {
+        shemaxfloat_t x = lo+(hi-lo)*k/64;
+        gap = std::max(gap, intercept+slope*x-f(x));
+      }
+      intercept -= gap/2;
+      worst = std::max(worst, gap/2/f(hi));
+      table.intercept.push_back(intercept);
+      table.slope.push_back(slope);
+    }
+  }
+  table.precision = (int)-std::log2(worst);
+  return table;
+}
+
+static SHEMathSeedTable rsqrtSeed = mkSeedTable(
+    [](shemaxfloat_t x) { return (shemaxfloat_t)(1.0/std::sqrt(x)); }, 2);
+static SHEMathSeedTable rcbrtSeed = mkSeedTable(
+    [](shemaxfloat_t x) { return (shemaxfloat_t)(1.0/std::cbrt(x)); }, 3);
+
+// look up the seed for x=m*2^r. Denormals aren't normalized first, so
+// they get a poor seed.
+static SHEFp newtonSeed(const SHEFp &x, const SHEInt &r,
+                        const SHEMathSeedTable &table)
+{
+  const SHEInt &mantissa = x.getMantissa();
+  int bits = std::min(SHEMATH_TABLE_BITS, mantissa.getSize()-1);
+  SHEInt index(mantissa);
+  index >>= mantissa.getSize()-1-bits;
+  index.reset(bits,true);
+  index.reset(SHEMATH_TABLE_BITS+2,true);
+  index <<= SHEMATH_TABLE_BITS-bits;
+  SHEInt row(r);
+  row.reset(SHEMATH_TABLE_BITS+2,true);
+  index += row << SHEMATH_TABLE_BITS;
+  return getVector(x,table.intercept,index) +
+         getVector(x,table.slope,index)*x;
+}
+
+// each newton step roughly doubles the good bits, only run the ones
+// we need for this mantissa size (or requested precision).
+static int newtonSteps(const SHEFp &x, const SHEMathSeedTable &table)
+{
+  int precision = table.precision;
+  int bits = SHEMathPrecisionBits(x.getMantissa().getSize());
+  int steps = 0;
+  while ((precision <= bits) &&
+         (steps < SHEMATH_NEWTON_LOOP_COUNT)) {
+    precision = 2*precision-1;
+    steps++;
+  }
+  return steps;
+}
+
+// split |a| into x*2^(2*k), x in [0.5,2)
+static SHEFp sqrtSplit(const SHEFp &a, SHEInt &k, SHEInt &r)
+{
+  SHEInt exp(a.getUnbiasedExp());
+  SHEFp x(a.abs());
+  r = exp.getBit(0);
+  SHEInt rs(r);
+  rs.reset(exp.getSize(),true);
+  rs.reset(exp.getSize(),false);
+  k = (exp - rs) >> 1;
+  x.setUnbiasedExp(rs);
+  return x;
+}
+
+// 1/sqrt(x) with newton's y=y*(1.5-(x/2)*y^2), no divides
+static SHEFp rsqrtNewton(const SHEFp &x, const SHEInt &r)
+{
+  SHEFp y(newtonSeed(x,r,rsqrtSeed));
+  SHEFp halfX(x);
+  halfX.setUnbiasedExp(x.getUnbiasedExp()-1);
+  int steps = newtonSteps(x,rsqrtSeed);
   if (sheMathLog)
-    (*sheMathLog) << "sqrt(" << (SHEFpSummary)a << ") = " << std::endl
+    (*sheMathLog) << "rsqrt(" << (SHEFpSummary)x << ") = " << std::endl
                   << " step 0 : y0=" << (SHEFpSummary) y
                   << std::endl;
-  for (int i=0; i < SHEMATH_NEWTON_LOOP_COUNT; i++) {
-    // newton's sqrt
-    y=.5*y+x/y;
+  for (int i=0; i < steps; i++) {
+    y=y*(1.5-halfX*(y*y));
     if (sheMathLog) (*sheMathLog) << " step " << (i+1) << ": y" << (i+1) << "="
                                   << (SHEFpSummary) y << std::endl;
   }
+  return y;
+}
+
+SHEFp rsqrt(const SHEFp &a)
+{
+  SHEInt k(a.getExp());
+  SHEInt r(a.getExp());
+  SHEFp x = sqrtSplit(a,k,r);
+  SHEFp y = ldexp(rsqrtNewton(x,r),-k);
+  y = select(a.isInf(), 0.0, y);
+  y = select(a.isZero(), INFINITY, y);
+  y = select(a.getSign() && !a.isZero(), NAN, y);
+  y = select(a.isNan(), NAN, y);
+  return y;
+}
+
+// sqrt(x) = x*rsqrt(x), and one more correction step
+// s=s+(y/2)*(x-s^2) to clean up the last bits.
+SHEFp sqrt(const SHEFp &a)
+{
+  SHEInt k(a.getExp());
+  SHEInt r(a.getExp());
+  SHEFp x = sqrtSplit(a,k,r);
+  SHEFp y = rsqrtNewton(x,r);
+  SHEFp s = x*y;
+  SHEFp halfY(y);
+  halfY.setUnbiasedExp(y.getUnbiasedExp()-1);
+  s += halfY*(x-s*s);
+  y = ldexp(s,k);
   y = select(a.isInf(), INFINITY, y);
   y = select(a.getSign(), NAN, y);
   y = select(a.isZero(), 0.0, y);
+  y = select(a.isNan(), NAN, y);
   return y;
 }
 
-// see comment for sqrt
+// cbrt uses 1/cbrt(x) with newton's y=y*(4/3-(x/3)*y^3), then
+// cbrt(x) = x*y^2. The exponent split needs e mod 3, which we get from
+// a small integer divide on the biased exponent.
 SHEFp cbrt(const SHEFp &a)
 {
-  SHEFp y(a.abs());
+  int expSize = a.getExp().getSize();
+  uint64_t bias = (1ULL << (expSize-1))-1;
+  // offset the biased exponent so that offset+bias is a multiple of 3
+  uint64_t offset = (3 - bias%3)%3;
+  SHEInt biasedExp(a.getExp());
+  biasedExp.reset(expSize+1,true);
+  biasedExp += offset;
+  SHEInt k(biasedExp);
+  SHEInt r(biasedExp);
+  biasedExp.divmod(SHEInt(biasedExp,(uint64_t)3), k, r);
+  k.reset(expSize+1,false);
+  k -= (offset+bias)/3;
+  r.reset(2,true);
+  SHEInt rs(r);
+  rs.reset(expSize,true);
+  rs.reset(expSize,false);
   SHEFp x(a.abs());
-  SHEInt exp(a.getExp());
-  SHEFp man = frexp(a,exp);
-  exp = exp/3;
-  man *= 2;
-  y=ldexp(man,exp);
-  x *= (1.0/3.0);
+  x.setUnbiasedExp(rs);
+
+  SHEFp y(newtonSeed(x,r,rcbrtSeed));
+  SHEFp thirdX(x*(1.0/3.0));
+  int steps = newtonSteps(x,rcbrtSeed);
   if (sheMathLog)
-    (*sheMathLog) << "cqrt(" << (SHEFpSummary)a << ") = " << std::endl
+    (*sheMathLog) << "cbrt(" << (SHEFpSummary)a << ") = " << std::endl
                   << " step 0 : y0=" << (SHEFpSummary) y
                   << std::endl;
-  for (int i=0; i < SHEMATH_NEWTON_LOOP_COUNT; i++) {
-    // newton's for cbrt.
-    y=(2.0/3.0)*y+x/(y*y);
+  for (int i=0; i < steps; i++) {
+    y=y*((4.0/3.0)-thirdX*(y*y*y));
     if (sheMathLog) (*sheMathLog) << " step " << (i+1) << ": y" << (i+1) << "="
                                   << (SHEFpSummary) y << std::endl;
   }
+  y = ldexp(x*(y*y),k);
   y = select(a.isInf(), INFINITY, y);
-  y = select(a.getSign(), NAN, y);
   y = select(a.isZero(), 0.0, y);
+  y.setSign(a.getSign());
+  y = select(a.isNan(), NAN, y);
   return y;
 }
 
@@ -1315,175 +1416,340 @@ SHEFp remquo(const SHEFp &a, shemaxfloat_t b, SHEInt &q)
 }
 
 //
-// these are not yet implemented
-SHEFp erf(const SHEFp &a)
-{
-  SHEFp result(a, 0.0);
-  SHEFp x(a, 0.0);
-  // note:Loop count must be even!
-  // Using Simson's rule: sn= delta_x/3*(f0 + 4f1 + 2f2 + 4f3 + 2f4 + 4f5 + f6)
-  SHEFp deltaX(a/(SHEMATH_INTEGRAL_LOOP_COUNT-1));
-  SHEFp deltaX3(deltaX/3.0);
-  SHEFp deltaX4_3((4.0/3.0)*deltaX);
-  SHEFp deltaX2_3((2.0/3.0)*deltaX);
-  if (sheMathLog)
-    (*sheMathLog) << "erf(" << (SHEFpSummary) a << ")" << std::endl
-                  << "*setup : x="  << (SHEFpSummary) x
-                  << " deltaX=" << (SHEFpSummary) deltaX
-                  << " deltaX/3=" << (SHEFpSummary) deltaX3 << std::endl;
-  for (int i=0; i < SHEMATH_INTEGRAL_LOOP_COUNT; i++) {
-    // we multiply the coefficient to our constant 1
-    SHEFp f = exp(-x*x);    // = f(x)
-    if ((i==0) || i==(SHEMATH_INTEGRAL_LOOP_COUNT-1)) {
-      result += f*deltaX3;
-    } else if (i & 1) {
-      result += f*deltaX4_3;
+// piecewise chebyshev fits for the special functions. For each row (the
+// order for bessel functions, otherwise just one) f is fit over intervals
+// of [lo,lo+width*2^intervalBits). The interval comes from the integer part
+// of (x-lo)/width, and the coefficients for the interval (and row) are
+// selected obliviously, so only one set of chebyshev polynomials is
+// evaluated no matter how many intervals there are.
+//
+class SHEMathPiecewise {
+private:
+  std::vector<SHEPolynomial> fits; // row major
+  shemaxfloat_t lo;
+  shemaxfloat_t width;
+  int intervalBits;
+
+  // x mapped onto [-1,1) within its interval, and the interval
+  SHEFp localX(const SHEFp &x, SHEInt &interval) const
+  {
+    SHEFp n(x);
+    if (lo != 0.0) {
+      n = n - lo;
+    }
+    if (width != 1.0) {
+      n = n*(1.0/width);
+    }
+    interval = n.toSHEInt();
+    interval.reset(intervalBits,true);
+    return n.fract()*2.0 - 1.0;
+  }
+  SHEFp evaluate(const SHEFp &x, const SHEInt &index, int first,
+                 int count) const
+  {
+    SHEInt interval(index);
+    SHEFp t = localX(x, interval);
+    SHEInt hotIndex(index);
+    if (count == (1 << intervalBits)) {
+      hotIndex = interval;
     } else {
-      result += f*deltaX2_3;
+      hotIndex.reset(index.getSize()+intervalBits,true);
+      hotIndex <<= intervalBits;
+      interval.reset(hotIndex.getSize(),true);
+      hotIndex ^= interval;
+    }
+    std::vector<SHEInt> hot = hotIndex.decode();
+    // use the largest degree any candidate fit needs at this precision
+    shemaxfloat_t epsilon = polyEpsilon(x);
+    int degree = 0;
+    for (int i=first; i < first+count; i++) {
+      degree = std::max(degree, fits[i].trim(epsilon).getDegree());
+    }
+    // T_0..T_degree, T_(a+b) = 2*T_a*T_b - T_(a-b)
+    std::vector<SHEFp> basis;
+    basis.push_back(SHEFp(x,1.0));
+    basis.push_back(t);
+    for (int k=2; k <= degree; k++) {
+      int h = k/2;
+      SHEFp tk(basis[h]*basis[k-h]);
+      basis.push_back(tk + tk - basis[k-2*h]);
     }
-     if (sheMathLog)
-        (*sheMathLog) << "*step " << i << " : x=" << (SHEFpSummary) x
-                      << " f(x)=" << (SHEFpSummary) f << " result="
-                      << (SHEFpSummary) result << std::endl;
-    x += deltaX;
+    SHEFp result(x,0.0);
+    for (int k=0; k <= degree; k++) {
+      SHEFp coeff(x,0.0);
+      for (int i=0; i < count; i++) {
+        const std::vector<shemaxfloat_t> &c = fits[first+i].getCoefficients();
+        coeff = select(hot[i], k < c.size() ? c[k] : 0.0, coeff);
+      }
+      result = (k == 0) ? coeff : result + coeff*basis[k];
+    }
+    return result;
   }
 
-  // close to 1
-  return M_2_SQRTPI * result;
+public:
+  SHEMathPiecewise(const std::function<shemaxfloat_t(int, shemaxfloat_t)> &f,
+                   shemaxfloat_t lo_, shemaxfloat_t width_, int rowBits,
+                   int intervalBits_) :
+                   lo(lo_), width(width_), intervalBits(intervalBits_)
+  {
+    for (int row=0; row < (1 << rowBits); row++) {
+      for (int i=0; i < (1 << intervalBits); i++) {
+        fits.push_back(SHEPolynomial::chebyshev(
+                [&f,row](shemaxfloat_t x) { return f(row,x); },
+                SHEMATH_APPROX_DEGREE, lo+i*width, lo+(i+1)*width));
+      }
+    }
+  }
+  shemaxfloat_t getHigh(void) const
+  { return lo + width*(1 << intervalBits); }
+
+  // x >= lo, results past getHigh() are garbage
+  SHEFp evaluate(const SHEFp &x, int row=0) const
+  {
+    SHEInt interval(x.getExp());
+    return evaluate(x, interval, row << intervalBits, 1 << intervalBits);
+  }
+  SHEFp evaluate(const SHEFp &x, const SHEInt &row) const
+  { return evaluate(x, row, 0, fits.size()); }
+};
+
+// erf is odd and rounds to 1 past the end of the fit
+static const SHEMathPiecewise erfFit(
+    [](int, shemaxfloat_t x) { return (shemaxfloat_t)std::erf(x); },
+    0.0, 0.75, 0, 3);
+
+SHEFp erf(const SHEFp &a)
+{
+  SHEFp x(a.abs());
+  SHEFp result = erfFit.evaluate(x);
+  if (sheMathLog)
+    (*sheMathLog) << "erf(" << (SHEFpSummary) a << ") fit="
+                  << (SHEFpSummary) result << std::endl;
+  result = select(x >= erfFit.getHigh(), 1.0, result);
+  result.setSign(a.getSign());
+  return select(a.isNan(), NAN, result);
 }
 
 SHEFp erfc(const SHEFp &a) { return 1.0  - erf(a); }
 
-SHEFp j0(const SHEFp &a)
+// log(gamma(z)) for z >= .5. Below the end of the fit we use a piecewise
+// fit, above it stirling's series
+//   (z-.5)*log(z) - z + log(2*pi)/2 + sum(B2k/(2k(2k-1)z^(2k-1)))
+static const SHEMathPiecewise lgammaFit(
+    [](int, shemaxfloat_t x) { return (shemaxfloat_t)std::lgamma(x); },
+    0.5, 1.0, 0, 3);
+static const SHEPolynomial stirlingPoly(
+    { 1.0/12.0, -1.0/360.0, 1.0/1260.0, -1.0/1680.0, 1.0/1188.0,
+      -691.0/360360.0, 1.0/156.0, -3617.0/122400.0 },
+    SHEPolyMonomial, 0.0, 1.0/(lgammaFit.getHigh()*lgammaFit.getHigh()));
+
+static SHEFp lgammaPositive(const SHEFp &z)
+{
+  SHEFp small = lgammaFit.evaluate(z);
+  SHEFp inv(1.0/z);
+  SHEFp large = (z-0.5)*log(z) - z + 0.5*std::log(2.0*M_PI) +
+                inv*stirlingPoly.trim(polyEpsilon(z)).evaluate(inv*inv);
+  if (sheMathLog)
+    (*sheMathLog) << "lgamma(" << (SHEFpSummary) z << ") fit="
+                  << (SHEFpSummary) small << " stirling="
+                  << (SHEFpSummary) large << std::endl;
+  return select(z < lgammaFit.getHigh(), small, large);
+}
+
+// values below .5 use the reflection gamma(a)*gamma(1-a) = pi/sin(pi*a)
+SHEFp tgamma(const SHEFp &a)
 {
-  SHEFp term(a,1.0);
-  SHEFp x(a.abs());
-  SHEFp x2=x*x;
-  // result is good for x < 1.0
-  SHEFp result(a,1.0);
-  for (int i=1; i < SHEMATH_BESSEL_LOOP_COUNT; i++) {
-    term*=1.0/((double)(4*i*i))*x2; // (1/(2^2i(i!)^2)) * x^2i
-    if (i&1) {
-      result -= term;
-    } else {
-      result += term;
-    }
-  }
-  // result2 is good for x >= 1.0
-  SHEFp result2(1.0/sqrt(x));
-  result2 *= cos(x-M_PI_4);
-  result2 *= M_2_SQRTPI;
-  result=select(x<1.0, result, result2);
-  copysign(result, a);
+  SHEFpBool reflect = a < 0.5;
+  SHEFp z = reflect.select(1.0-a, a);
+  SHEFp lg = lgammaPositive(z);
+  SHEFp e = exp(reflect.select(-lg, lg));
+  SHEFp result = reflect.select((M_PI*e)/sin(M_PI*a), e);
+  result = select(a.isInf() && !a.getSign(), INFINITY, result);
+  return select(a.isNan(), NAN, result);
+}
+
+SHEFp lgamma_r(const SHEFp &a, SHEInt &signp)
+{
+  SHEFpBool reflect = a < 0.5;
+  SHEFp z = reflect.select(1.0-a, a);
+  SHEFp lg = lgammaPositive(z);
+  SHEFp s = sin(M_PI*a);
+  SHEFp result = reflect.select(std::log(M_PI) - log(s.abs()) - lg, lg);
+  result = select(a.isInf(), INFINITY, result);
+  result = select(a.isNan(), NAN, result);
+  SHEInt8 signOut(a.getExp(), 1);
+  // this emulates the real math.h semantics of -1 = negative and
+  // 1 = positive or zero
+  signp = (reflect && s.getSign() && !s.isZero()).select(-1, signOut);
   return result;
 }
 
-SHEFp y0(const SHEFp &a)
+SHEFp lgamma(const SHEFp &a)
 {
-  SHEFp jterm(a,1.0);
-  SHEFp x(a.abs());
-  SHEFp x2=x*x;
-  SHEFp j0_const=.5772+log(.5*a);// need a more precise gamma
-  double Hi=0.0;
-  // result is good for x < 1.0
-  SHEFp result(j0_const);
-  for (int i=1; i < SHEMATH_BESSEL_LOOP_COUNT; i++) {
-    jterm*=1.0/((double)(4*i*i))*x2; // (1/(2^2i(i!)^2)) * x^2i
-    Hi += 1.0/(double)i;
-    SHEFp term = jterm *(j0_const-Hi);
-    if (i&1) {
-      result -= term;
-    } else {
-      result += term;
+  // the normal library returns signp in a global
+  // That's not safe at all in our library since
+  // we need a public key to initialize the global
+  // and there isn't necessarily one available. apps
+  // that need sign can call lgamma_r.
+  SHEInt8 signp(a.getExp(), 1);
+  return lgamma_r(a, signp);
+}
+
+//
+// Bessel functions. Below besselHigh j comes from a piecewise fit for
+// each order up to 2^SHEMATH_BESSEL_ORDER_BITS-1. y0 and y1 have log
+// (and 1/x) singularities at 0, so we fit the smooth remainders
+//   y0(x) - (2/pi)*log(x)*j0(x)
+//   y1(x) - (2/pi)*(log(x)*j1(x) - 1/x)
+// Above besselHigh orders 0 and 1 use the hankel form
+//   j(x) = sqrt(2/(pi*x))*(P*cos(chi) - Q*sin(chi))
+//   y(x) = sqrt(2/(pi*x))*(P*sin(chi) + Q*cos(chi))
+// chi = x-(2n+1)*pi/4, with P and Q/x fit as functions of 1/x^2 from the
+// library values. Higher orders come from the forward recurrence, which
+// is stable for y, and for j once x > n.
+//
+static const shemaxfloat_t besselHigh = 16.0;
+static const SHEMathPiecewise besselJFit(
+    [](int n, shemaxfloat_t x) { return (shemaxfloat_t)::jn(n,(double)x); },
+    0.0, besselHigh/16, SHEMATH_BESSEL_ORDER_BITS, 4);
+
+static shemaxfloat_t besselYRemainder(int n, shemaxfloat_t x)
+{
+  double xd = x;
+  if (n == 0) {
+    return ::y0(xd) - M_2_PI*std::log(xd)*::j0(xd);
+  }
+  return ::y1(xd) - M_2_PI*(std::log(xd)*::j1(xd) - 1.0/xd);
+}
+static const SHEMathPiecewise besselYFit(besselYRemainder,
+    0.0, besselHigh/16, 1, 4);
+
+static shemaxfloat_t besselHankel(int n, bool isQ, shemaxfloat_t v)
+{
+  double x = 1.0/std::sqrt((double)v);
+  double chi = x - (2*n+1)*M_PI_4;
+  double j = n ? ::j1(x) : ::j0(x);
+  double y = n ? ::y1(x) : ::y0(x);
+  double scale = std::sqrt(M_PI_2*x);
+  if (isQ) {
+    return scale*(y*std::cos(chi) - j*std::sin(chi))*x;
+  }
+  return scale*(j*std::cos(chi) + y*std::sin(chi));
+}
+static const SHEPolynomial besselP[2] = {
+  SHEPolynomial::chebyshev(
+    [](shemaxfloat_t v) { return besselHankel(0, false, v); },
+    SHEMATH_APPROX_DEGREE, 0.0, 1.0/(besselHigh*besselHigh)),
+  SHEPolynomial::chebyshev(
+    [](shemaxfloat_t v) { return besselHankel(1, false, v); },
+    SHEMATH_APPROX_DEGREE, 0.0, 1.0/(besselHigh*besselHigh))
+};
+static const SHEPolynomial besselQ[2] = {
+  SHEPolynomial::chebyshev(
+    [](shemaxfloat_t v) { return besselHankel(0, true, v); },
+    SHEMATH_APPROX_DEGREE, 0.0, 1.0/(besselHigh*besselHigh)),
+  SHEPolynomial::chebyshev(
+    [](shemaxfloat_t v) { return besselHankel(1, true, v); },
+    SHEMATH_APPROX_DEGREE, 0.0, 1.0/(besselHigh*besselHigh))
+};
+
+// orders first..last (0 or 1) of j and/or y from the hankel form
+static void besselHankel(const SHEFp &x, const SHEFp &inv, int first,
+                         int last, SHEFp *j, SHEFp *y)
+{
+  SHEFp v(inv*inv);
+  SHEFp amp(rsqrt(x)*std::sqrt(M_2_PI));
+  SHEFp s(x), c(x);
+  trigTableReduce(x,s,c);
+  // chi_0 = x-pi/4
+  SHEFp cosChi((c+s)*M_SQRT1_2);
+  SHEFp sinChi((s-c)*M_SQRT1_2);
+  shemaxfloat_t epsilon = polyEpsilon(x);
+  for (int n=0; n <= last; n++) {
+    if (n >= first) {
+      SHEFp p(besselP[n].trim(epsilon).evaluate(v));
+      SHEFp q(inv*besselQ[n].trim(epsilon).evaluate(v));
+      if (j) j[n] = amp*(p*cosChi - q*sinChi);
+      if (y) y[n] = amp*(p*sinChi + q*cosChi);
     }
+    // chi_(n+1) = chi_n - pi/2
+    SHEFp t(cosChi);
+    cosChi = sinChi;
+    sinChi = -t;
   }
-  // result2 is good for x >= 1.0
-  SHEFp result2(1.0/sqrt(x));
-  result2 *= sin(x-M_PI_4);
-  result2 *= M_2_SQRTPI;
-  result=select(x<1.0, result, result2);
-  copysign(result, a);
-  return result;
 }
 
-SHEFp tgamma(const SHEFp &a)
+// y of orders first..last (0 or 1) for x > 0
+static void besselY01(const SHEFp &x, const SHEFp &inv, int first, int last,
+                      SHEFp *y)
 {
-  SHEFp result(a, 0.0);
-  SHEFp t(a, 0.0);
-  SHEFp x(a-1.0);
-  // note:Loop count must be even!
-  // Using Simson's rule: sn= delta_x/3*(f0 + 4f1 + 2f2 + 4f3 + 2f4 + 4f5 + f6)
-  shemaxfloat_t minfloat = a.getMin();
-  // The integral is from '0' to infinity, which is really from 0 until f goes
-  // to zero. This is dominated by exp(-t), but allow t^x. A better gues would
-  // be to divide log(minfloat) by -x
-  shemaxfloat_t deltaT = (log(minfloat)/-6.0)/(SHEMATH_INTEGRAL_LOOP_COUNT-1);
-  shemaxfloat_t  deltaT3 = deltaT/3.0;
-  shemaxfloat_t deltaT4_3 = (4.0/3.0)*deltaT;
-  shemaxfloat_t  deltaT2_3 = (2.0/3.0)*deltaT;
-  if (sheMathLog)
-    (*sheMathLog) << "gamma(" << (SHEFpSummary) a << ")" << std::endl
-                  << "*setup : t="  << (SHEFpSummary) t
-                  << " x="  << (SHEFpSummary) x
-                  << " deltaT=" << deltaT << std::endl;
-  t = deltaT; // since the first term is zero, we can skip the calculation
-  for (int i=1; i < SHEMATH_INTEGRAL_LOOP_COUNT; i++) {
-    // we multiply the coefficient to our constant 1
-    SHEFp tp = pow(t,x);
-    SHEFp ep = exp(-t);
-    SHEFp f = tp*ep;    // = f(t)
-    // first and last terms multiply by deltaT/3.0
-    // second, second to last terms, and alternating terms
-    //   multiply by 4*deltaT/3.0
-    // middle terms multiply by 2*deltaT/3.0, Loop_count needs
-    // to be odd and >= 3.
-    if ((i==0) || i==(SHEMATH_INTEGRAL_LOOP_COUNT-1)) {
-      result += f*deltaT3;
-    } else if (i & 1) {
-      result += f*deltaT4_3;
-    } else {
-      result += f*deltaT2_3;
+  SHEFp logX(log(x));
+  SHEFp yl[2] = { x, x };
+  besselHankel(x, inv, first, last, nullptr, yl);
+  for (int n=first; n <= last; n++) {
+    SHEFp js(besselJFit.evaluate(x,n));
+    SHEFp ys(logX*js);
+    if (n) {
+      ys -= inv;
     }
-     if (sheMathLog)
-        (*sheMathLog) << "*step " << i << " : t=" << (SHEFpSummary) t
-                      << " f(t)=" << (SHEFpSummary) f << " result="
-                      << (SHEFpSummary) result << std::endl;
-    x += deltaT;
+    ys = besselYFit.evaluate(x,n) + M_2_PI*ys;
+    y[n] = select(x < besselHigh, ys, yl[n]);
   }
+}
 
+// forward recurrence f_(k+1) = (2k/x)*f_k - f_(k-1), returning f_n
+static SHEFp besselRecur(const SHEFp &f0, const SHEFp &f1, const SHEFp &inv,
+                         const SHEInt &n, int maxOrder)
+{
+  SHEFp prev(f0);
+  SHEFp cur(f1);
+  SHEFp result(select(n == (uint64_t)0, f0, f1));
+  SHEFp twoInv(inv+inv);
+  SHEFp coeff(twoInv);
+  for (int k=1; k < maxOrder; k++) {
+    SHEFp next(coeff*cur - prev);
+    prev = cur;
+    cur = next;
+    coeff += twoInv;
+    result = select(n == (uint64_t)(k+1), cur, result);
+  }
   return result;
 }
 
-// There are better ways of doing this, but at least this 'works'
-SHEFp lgamma_r(const SHEFp &a, SHEInt &signp)
+// the largest order n can hold that we handle
+static int besselMaxOrder(const SHEInt &n)
 {
-  SHEFp gamma=tgamma(a);
-  SHEInt8 signOut(a.getExp(), 1);
-  // ideally we should just return gamma.getSign(), but this emulates
-  // the real math.h semantics of -1 = negative and 1 = positive or zero
-  signp = (gamma.getSign() && !gamma.isZero()).select(-1, signOut);
-  return log(gamma.abs());
+  int bits = n.getSize() - (n.getUnsigned() ? 0 : 1);
+  return (1 << std::min(bits, SHEMATH_BESSEL_ORDER_BITS)) - 1;
 }
 
+static SHEFp besselJ01(int order, const SHEFp &a)
+{
+  SHEFp x(a.abs());
+  SHEFp small(besselJFit.evaluate(x,order));
+  SHEFp jl[2] = { x, x };
+  besselHankel(x, 1.0/x, order, order, jl, nullptr);
+  SHEFp result(select(x < besselHigh, small, jl[order]));
+  if (order) {
+    result = SHEFpBool(a.getSign()).select(-result, result);
+  }
+  return select(a.isNan(), NAN, result);
+}
 
-SHEFp lgamma(const SHEFp &a)
+static SHEFp besselY01(int order, const SHEFp &a)
 {
-  SHEFp gamma=tgamma(a);
-  // the normal library returns signp in a global
-  // That's not safe at all in our library since
-  // we need a public key to initialize the global
-  // and there isn't necessarily one available. apps
-  // that need sign can call lgamma_r.
-  return log(gamma.abs());
+  SHEFp y[2] = { a, a };
+  besselY01(a, 1.0/a, order, order, y);
+  SHEFp result(y[order]);
+  result = select(a.isZero(), -INFINITY, result);
+  return select(a.getSign() || a.isNan(), NAN, result);
 }
 
-// obviously there's a better way than this.
-SHEFp j1(const SHEFp &a) { return jn((uint64_t) 1,a); }
+SHEFp j0(const SHEFp &a) { return besselJ01(0, a); }
+SHEFp j1(const SHEFp &a) { return besselJ01(1, a); }
+SHEFp y0(const SHEFp &a) { return besselY01(0, a); }
+SHEFp y1(const SHEFp &a) { return besselY01(1, a); }
 
-// these next two can do better by copying the jn function and
-// allowing more unencrypted operations before we drop into
-// encrypted operations, getting some performance without
-// suffering precision loss
 SHEFp jn(uint64_t n, const SHEFp &a)
 {
   SHEInt ni(a.getSign().getPublicKey(), n, SHEInt::getBitSize(n), true);
@@ -1495,52 +1761,32 @@ SHEFp jn(const SHEInt &n, shemaxfloat_t a)
   return jn(n, SHEFp(n.getPublicKey(),a));
 }
 
+// orders past besselMaxOrder() return NaN
 SHEFp jn(const SHEInt &n, const SHEFp &a)
 {
-  SHEFp result(a, 0.0);
-  SHEFp nf(a,n);
-  shemaxfloat_t x=0.0;
-  // note:Loop count must be even!
-  // Using Simson's rule: sn= delta_x/3*(f0 + 4f1 + 2f2 + 4f3 + 2f4 + 4f5 + f6)
-  shemaxfloat_t deltaX = M_PI/(SHEMATH_INTEGRAL_LOOP_COUNT-1);
-  shemaxfloat_t deltaX3 = deltaX/3.0;
-  shemaxfloat_t deltaX4_3 = (4.0/3.0)*deltaX;
-  shemaxfloat_t deltaX2_3 = (2.0/3.0)*deltaX;
+  SHEFp x(a.abs());
+  SHEInt order(n.abs());
+  order.reset(order.getSize(), true);
+  int maxOrder = besselMaxOrder(n);
+  SHEInt row(order);
+  row.reset(SHEMATH_BESSEL_ORDER_BITS, true);
+  SHEFp small(besselJFit.evaluate(x,row));
+  SHEFp inv(1.0/x);
+  SHEFp jl[2] = { x, x };
+  besselHankel(x, inv, 0, 1, jl, nullptr);
+  SHEFp large(besselRecur(jl[0], jl[1], inv, order, maxOrder));
   if (sheMathLog)
     (*sheMathLog) << "jn(" << (SHEIntSummary) n << ","
-                  << (SHEFpSummary) nf << "," << (SHEFpSummary) a << ")" << std::endl
-                  << "*setup : x="  << x
-                  << " nf*x="  << (SHEFpSummary)(nf*x)
-                  << " deltaX=" << deltaX
-                  << " deltaX/3=" << deltaX3 << std::endl;
-  for (int i=0; i < SHEMATH_INTEGRAL_LOOP_COUNT; i++) {
-    // we multiply the coefficient to our constant 1
-    SHEFp f = cos(nf*x) - a*shemaxfloat_sin(x);    // = f(x)
-    if ((i==0) || i==(SHEMATH_INTEGRAL_LOOP_COUNT-1)) {
-      result += f*deltaX3;
-    } else if (i & 1) {
-      result += f*deltaX4_3;
-    } else {
-      result += f*deltaX2_3;
-    }
-     if (sheMathLog)
-        (*sheMathLog) << "*step " << i << " : x=" << x
-                      << " f(x)=" << (SHEFpSummary) f << " result="
-                      << (SHEFpSummary) result << std::endl;
-    x += deltaX;
-  }
-
-  // close to 1
-  return M_1_PI * result;
+                  << (SHEFpSummary) a << ") fit=" << (SHEFpSummary) small
+                  << " recurrence=" << (SHEFpSummary) large << std::endl;
+  SHEFp result(select(x < besselHigh, small, large));
+  // j_n(-x) = j_-n(x) = (-1)^n j_n(x)
+  SHEInt flip((a.getSign() ^ n.isNegative()) && order.getBit(0));
+  result = SHEFpBool(flip).select(-result, result);
+  result = select(order > (uint64_t)maxOrder, NAN, result);
+  return select(a.isNan(), NAN, result);
 }
 
-// obviously there's a better way than this.
-SHEFp y1(const SHEFp &a) { return yn((uint64_t)1,a); }
-
-// these next two can do better by copying the jn function and
-// allowing more unencrypted operations before we drop into
-// encrypted operations, getting some performance without
-// suffering precision loss
 SHEFp yn(uint64_t n, const SHEFp &a)
 {
   SHEInt ni(a.getSign().getPublicKey(), n, SHEInt::getBitSize(n), true);
@@ -1552,41 +1798,25 @@ SHEFp yn(const SHEInt &n, shemaxfloat_t a)
   return yn(n, SHEFp(n.getPublicKey(),a));
 }
 
+// orders past besselMaxOrder() return NaN
 SHEFp yn(const SHEInt &n, const SHEFp &a)
 {
-  SHEFp result(a, 0.0);
-  SHEFp nf(a,n);
-  shemaxfloat_t x=0.0;
-  // note:Loop count must be even!
-  // Using Simson's rule: sn= delta_x/3*(f0 + 4f1 + 2f2 + 4f3 + 2f4 + 4f5 + f6)
-  shemaxfloat_t deltaX = M_PI/(SHEMATH_INTEGRAL_LOOP_COUNT-1);
-  shemaxfloat_t deltaX3 = deltaX/3.0;
-  shemaxfloat_t deltaX4_3 = (4.0/3.0)*deltaX;
-  shemaxfloat_t deltaX2_3 = (2.0/3.0)*deltaX;
+  SHEInt order(n.abs());
+  order.reset(order.getSize(), true);
+  int maxOrder = besselMaxOrder(n);
+  SHEFp inv(1.0/a);
+  SHEFp y[2] = { a, a };
+  besselY01(a, inv, 0, 1, y);
+  SHEFp result(besselRecur(y[0], y[1], inv, order, maxOrder));
   if (sheMathLog)
-    (*sheMathLog) << "yn(" << (SHEIntSummary) n << "("
-                  << (SHEFpSummary) nf << ")," << (SHEFpSummary) a << ")" << std::endl
-                  << "*setup : x="  << x
-                  << " deltaX=" << deltaX
-                  << " deltaX/3=" << deltaX3 << std::endl;
-  for (int i=0; i < SHEMATH_INTEGRAL_LOOP_COUNT; i++) {
-    // we multiply the coefficient to our constant 1
-    SHEFp f = sin(a*shemaxfloat_sin(x) - nf*x);    // = f(x)
-    if ((i==0) || i==(SHEMATH_INTEGRAL_LOOP_COUNT-1)) {
-      result += f*deltaX3;
-    } else if (i & 1) {
-      result += f*deltaX4_3;
-    } else {
-      result += f*deltaX2_3;
-    }
-     if (sheMathLog)
-        (*sheMathLog) << "*step " << i << " : x=" << x
-                      << " f(x)=" << (SHEFpSummary) f << " result="
-                      << (SHEFpSummary) result << std::endl;
-    x += deltaX;
-  }
-
-  // close to 1
-  return M_1_PI * result;
+    (*sheMathLog) << "yn(" << (SHEIntSummary) n << ","
+                  << (SHEFpSummary) a << ") = " << (SHEFpSummary) result
+                  << std::endl;
+  // y_-n(x) = (-1)^n y_n(x)
+  SHEInt flip(n.isNegative() && order.getBit(0));
+  result = SHEFpBool(flip).select(-result, result);
+  result = select(a.isZero(), -INFINITY, result);
+  result = select(order > (uint64_t)maxOrder, NAN, result);
+  return select(a.getSign() || a.isNan(), NAN, result);
 }
 //SHEFp nan(const char *) { return a; }
@@ -7,8 +7,13 @@
 // We should also include some decrypted scalar versions of the
 // functions that take 2 arguments at some point.
 //
+#ifndef SHEMath_H_
+#define SHEMath_H_ 1
+#include <vector>
 #include "SHEInt.h"
 #include "SHEFp.h"
+#include "SHEFixed.h"
+#include "SHEPolynomial.h"
 
 // "macros" (actually inline functions, but the originals in the unencrypted
 // space are macros).
@@ -44,6 +49,27 @@ inline SHEBool islessgreater(const SHEFp &x, const SHEFp &y)
 
 // utility functions
 void SHEMathSetLog(std::ostream &str);
+// Precision target, in bits, for the calling thread. Series lengths,
+// polynomial degrees and newton steps are trimmed to the smaller of this
+// and the operand's mantissa (or fraction) size. 0, the default, means
+// full precision. 3 significant digits is about 10 bits.
+void SHEMathSetPrecision(int bits);
+int SHEMathGetPrecision(void);
+inline int SHEMathPrecisionBits(int bits)
+{
+  int precision = SHEMathGetPrecision();
+  return (precision > 0 && precision < bits) ? precision : bits;
+}
+// set the precision target for the life of a scope (a call), and restore
+// the previous target on exit
+class SHEMathPrecision {
+private:
+  int saved;
+public:
+  SHEMathPrecision(int bits) : saved(SHEMathGetPrecision())
+  { SHEMathSetPrecision(bits); }
+  ~SHEMathPrecision() { SHEMathSetPrecision(saved); }
+};
 
 // functions, (implemented in SHEMath.cpp)
 SHEFp acos(const SHEFp &);
@@ -128,6 +154,11 @@ inline SHEFp nexttoward(const SHEFp & a, shemaxfloat_t b)
 SHEFp pow(const SHEFp &, const SHEFp &);
 SHEFp pow(shemaxfloat_t, const SHEFp &);
 SHEFp pow(const SHEFp &, shemaxfloat_t);
+// integer exponents by square and multiply, not in math.h
+SHEFp pow(const SHEFp &, const SHEInt &);
+SHEInt pow(const SHEInt &, const SHEInt &);
+SHEInt modpow(const SHEInt &, const SHEInt &, const SHEInt &);
+SHEInt modpow(const SHEInt &, const SHEInt &, uint64_t);
 SHEFp remainder(const SHEFp &, const SHEFp &);
 SHEFp remainder(shemaxfloat_t, const SHEFp &);
 SHEFp remainder(const SHEFp &, shemaxfloat_t);
@@ -136,11 +167,15 @@ SHEFp remquo(shemaxfloat_t, const SHEFp &, SHEInt &);
 SHEFp remquo(const SHEFp &, shemaxfloat_t, SHEInt &);
 SHEFp rint(const SHEFp &);
 SHEFp round(const SHEFp &);
+SHEFp rsqrt(const SHEFp &); // 1/sqrt(x), not in math.h
 SHEFp scalbn(const SHEFp &, const SHEInt &);
 SHEFp scalbn(shemaxfloat_t, const SHEInt &);
 SHEFp scalbn(const SHEFp &, uint64_t);
 SHEFp sin(const SHEFp &);
 SHEFp sinh(const SHEFp &);
+// both results from one range reduction, not in math.h
+void sincos(const SHEFp &, SHEFp &sinOut, SHEFp &cosOut);
+void sinhcosh(const SHEFp &, SHEFp &sinhOut, SHEFp &coshOut);
 SHEFp sqrt(const SHEFp &);
 SHEFp tan(const SHEFp &);
 SHEFp tanh(const SHEFp &);
@@ -151,3 +186,301 @@ SHEFp y1(const SHEFp &);
 SHEFp yn(const SHEInt &, const SHEFp &);
 SHEFp yn(uint64_t, const SHEFp &);
 SHEFp yn(const SHEInt &, shemaxfloat_t);
+
+// functions of one encrypted argument that share their range reductions.
+// The first function called from a family pays for the reduction and for
+// the power tables of its kernels, the rest of the family reuses them:
+//   SHEMathShared theta(angle);
+//   SHEFp x(r*theta.cos()), y(r*theta.sin());
+// The circular family is sin, cos and tan, the hyperbolic family is
+// sinh, cosh, tanh and exp.
+class SHEMathShared {
+private:
+  SHEFp arg;
+  bool haveTrig;
+  SHEFp sinValue;
+  SHEFp cosValue;
+  bool haveHyperbolic;
+  SHEFp expValue;
+  SHEFp expInvValue;
+  SHEFp sinhValue;
+  SHEFp coshValue;
+  void reduceTrig(void);
+  void reduceHyperbolic(void);
+public:
+  SHEMathShared(const SHEFp &a) : arg(a), haveTrig(false), sinValue(a),
+      cosValue(a), haveHyperbolic(false), expValue(a), expInvValue(a),
+      sinhValue(a), coshValue(a) {}
+  const SHEFp &getArg(void) const { return arg; }
+  SHEFp sin(void);
+  SHEFp cos(void);
+  SHEFp tan(void);
+  SHEFp sinh(void);
+  SHEFp cosh(void);
+  SHEFp tanh(void);
+  SHEFp exp(void);
+};
+
+///////////////////////////////////////////////////////////////////////////
+//                     fixed point versions                              /
+///////////////////////////////////////////////////////////////////////////
+//
+// These work directly on the scaled integer, so they never pay for the
+// exponent alignment and normalization SHEFp needs. Each function picks
+// its iteration count from fracBits, so results are good to about the last
+// couple of fraction bits. The polynomial fits need intBits >= 2 so
+// their chebyshev terms don't overflow.
+//
+
+// helpers
+// does x have any non-zero fraction bits
+template<int I, int F>
+inline SHEInt sheFixedHasFract(const SHEFixed<I,F> &x)
+{
+  SHEInt fract(x.getValue());
+  if (F == 0) {
+    return SHEInt(fract.getPublicKey(), (uint64_t)0, 1, true);
+  }
+  fract.reset(F, true);
+  return fract.isNotZero();
+}
+
+// add an encrypted 0 or 1 to the integer part of x
+template<int I, int F>
+inline SHEFixed<I,F> sheFixedAddBit(const SHEFixed<I,F> &x, const SHEInt &bit)
+{
+  SHEInt one(bit);
+  one.reset(I+F, true);
+  one.reset(I+F, false);
+  one <<= F;
+  SHEFixed<I,F> result(x);
+  result.setValue(x.getValue() + one);
+  return result;
+}
+
+// the error we can tolerate in a polynomial, half of the last bit
+// (or of the last requested bit)
+template<int I, int F>
+inline shemaxfloat_t sheFixedEpsilon(const SHEFixed<I,F> &x)
+{ return std::ldexp((shemaxfloat_t)1.0, -(SHEMathPrecisionBits(F)+1)); }
+
+// rounding
+template<int I, int F>
+inline SHEFixed<I,F> floor(const SHEFixed<I,F> &x)
+{
+  // two's complement, so clearing the fraction rounds toward -infinity
+  SHEInt raw(x.getValue());
+  SHEInt zero(raw.getPublicKey(), (uint64_t)0, 1, true);
+  for (int i=0; i < F; i++) {
+    raw.setBit(i, zero);
+  }
+  SHEFixed<I,F> result(x);
+  result.setValue(raw);
+  return result;
+}
+template<int I, int F>
+inline SHEFixed<I,F> ceil(const SHEFixed<I,F> &x)
+{ return sheFixedAddBit(floor(x), sheFixedHasFract(x)); }
+template<int I, int F>
+inline SHEFixed<I,F> trunc(const SHEFixed<I,F> &x)
+{ return sheFixedAddBit(floor(x), sheFixedHasFract(x) && x.isNegative()); }
+// round half away from zero
+template<int I, int F>
+inline SHEFixed<I,F> round(const SHEFixed<I,F> &x)
+{
+  SHEFixed<I,F> result(floor(x.abs() + 0.5));
+  return select(x.isNegative(), -result, result);
+}
+
+// simple functions
+template<int I, int F>
+inline SHEFixed<I,F> fabs(const SHEFixed<I,F> &x) { return x.abs(); }
+template<int I, int F>
+inline SHEFixed<I,F> fmin(const SHEFixed<I,F> &x, const SHEFixed<I,F> &y)
+{ return select(x < y, x, y); }
+template<int I, int F>
+inline SHEFixed<I,F> fmax(const SHEFixed<I,F> &x, const SHEFixed<I,F> &y)
+{ return select(x > y, x, y); }
+template<int I, int F>
+inline SHEFixed<I,F> fdim(const SHEFixed<I,F> &x, const SHEFixed<I,F> &y)
+{ return select(x > y, x - y, 0.0); }
+template<int I, int F>
+inline SHEFixed<I,F> fma(const SHEFixed<I,F> &x, const SHEFixed<I,F> &y,
+                         const SHEFixed<I,F> &z)
+{ return x*y + z; }
+template<int I, int F>
+inline SHEFixed<I,F> copysign(const SHEFixed<I,F> &x, const SHEFixed<I,F> &y)
+{ return select(x.isNegative() ^ y.isNegative(), -x, x); }
+
+// sqrt uses the digit by digit method on raw << F, one subtract and one
+// select per result bit, no multiplies. Negative inputs return 0.
+template<int I, int F>
+inline SHEFixed<I,F> sqrt(const SHEFixed<I,F> &x)
+{
+  const SHEInt &raw = x.getValue();
+  const SHEPublicKey &pubKey = raw.getPublicKey();
+  int inBits = I+F-1+F;  // magnitude bits of raw << F
+  int pairs = (inBits+1)/2;
+  int size = pairs+3;
+  SHEInt rem(pubKey, (uint64_t)0, size, false);
+  SHEInt root(pubKey, (uint64_t)0, size, false);
+  SHEInt one(pubKey, (uint64_t)1, 1, true);
+
+  for (int i=pairs-1; i >= 0; i--) {
+    rem <<= 2;
+    rem.setBit(1, raw.getBit(2*i+1-F));
+    rem.setBit(0, raw.getBit(2*i-F));
+    SHEInt trial(root << 2);
+    trial.setBit(0, one);
+    SHEInt diff(rem - trial);
+    SHEInt ge(!diff.isNegative());
+    rem = ge.select(diff, rem);
+    root <<= 1;
+    root.setBit(0, ge);
+  }
+  root.reset(I+F, false);
+  SHEFixed<I,F> result(x);
+  result.setValue(root);
+  return select(x.isNegative(), 0.0, result);
+}
+
+// exp2 splits x into an integer and a fraction. 2^fraction comes from a
+// chebyshev fit, the integer part is then just a shift.
+template<int I, int F>
+inline SHEFixed<I,F> exp2(const SHEFixed<I,F> &x)
+{
+  const SHEInt &raw = x.getValue();
+  SHEInt ipart(raw >> F);
+  ipart.reset(I, false);
+  SHEInt fraw(raw);
+  fraw.reset(std::max(F,1), true);
+  fraw.reset(I+F, true);
+  fraw.reset(I+F, false);
+  if (F == 0) {
+    fraw = SHEInt(raw, (uint64_t)0);
+  }
+  SHEFixed<I,F> fract(x);
+  fract.setValue(fraw);
+
+  static const SHEPolynomial exp2Poly = SHEPolynomial::chebyshev(
+      [](shemaxfloat_t f) { return (shemaxfloat_t)std::exp2(f); },
+      SHEMATH_TRIG_LOOP_COUNT, 0.0, 1.0);
+  SHEFixed<I,F> p(exp2Poly.trim(sheFixedEpsilon(x)).evaluate(fract));
+
+  // p is in [1,2) so shifts up to I-2 always fit
+  SHEInt scaled(p.getValue().leftShiftSigned(ipart));
+  SHEInt maxv(scaled, (uint64_t)SHEFixed<I,F>::maxRaw);
+  scaled = (ipart > (int64_t)(I-2)).select(maxv, scaled);
+  SHEFixed<I,F> result(x);
+  result.setValue(scaled);
+  return result;
+}
+template<int I, int F>
+inline SHEFixed<I,F> exp(const SHEFixed<I,F> &x)
+{ return exp2(x*M_LOG2E); }
+
+// log2 finds the leading one with a row per bit position, which gives the
+// integer part and a mantissa in [1,2). Each fraction bit then comes from
+// squaring the mantissa: m^2 >= 2 means the bit is set. Values <= 0
+// return the most negative value.
+template<int I, int F>
+inline SHEFixed<I,F> log2(const SHEFixed<I,F> &x)
+{
+  constexpr int T = I+F;
+  const SHEInt &raw = x.getValue();
+  const SHEPublicKey &pubKey = raw.getPublicKey();
+  // mantissa precision, with a few guard bits for the squarings
+  int prec = F+3;
+  int msize = prec+2;
+  SHEInt src(raw);
+  src.reset(std::max(T, msize), false);
+  SHEInt m(pubKey, (uint64_t)0, msize, true);
+  SHEInt result(pubKey, (uint64_t)0, T, false);
+  SHEInt seen(pubKey, (uint64_t)0, 1, true);
+
+  for (int p=T-2; p >= 0; p--) {
+    SHEInt bit(raw.getBit(p));
+    SHEInt row(p == T-2 ? bit : bit && !seen);
+    seen = (p == T-2) ? bit : seen || bit;
+    SHEInt shifted(p > prec ? src >> (p-prec) : src << (prec-p));
+    shifted.reset(msize, true);
+    SHEInt mask(row);
+    mask.reset(msize, false);
+    m ^= mask & shifted;
+    int64_t c = SHEFixed<I,F>::toRaw(p - F); // saturates
+    mask = row;
+    mask.reset(T, false);
+    result ^= mask & (uint64_t)c;
+  }
+  // fraction bits past the requested precision stay zero
+  for (int k=F-1; k >= F-SHEMathPrecisionBits(F); k--) {
+    SHEInt sq(m);
+    SHEInt m2(m);
+    sq.reset(2*msize, true);
+    m2.reset(2*msize, true);
+    sq *= m2;
+    sq >>= prec;
+    sq.reset(msize, true);
+    SHEInt bit(sq.getBit(prec+1));
+    m = bit.select(sq >> 1, sq);
+    result.setBit(k, bit);
+  }
+  SHEFixed<I,F> out(x);
+  out.setValue(result);
+  return select(raw.isNonPositive(),
+                SHEFixed<I,F>::fromRaw(SHEFixed<I,F>::minRaw), out);
+}
+template<int I, int F>
+inline SHEFixed<I,F> log(const SHEFixed<I,F> &x) { return log2(x)*M_LN2; }
+template<int I, int F>
+inline SHEFixed<I,F> log10(const SHEFixed<I,F> &x)
+{ return log2(x)*(M_LN2/M_LN10); }
+
+// sin and cos reduce x by the nearest multiple of pi/2 (a constant
+// multiply) and evaluate chebyshev fits in r^2 on the remainder r in
+// [-pi/4,pi/4]. The low bits of the multiple pick the quadrant.
+template<int I, int F>
+inline void sheFixedSinCos(const SHEFixed<I,F> &x, SHEFixed<I,F> *sinOut,
+                           SHEFixed<I,F> *cosOut)
+{
+  SHEFixed<I,F> k(floor(x*M_2_PI + 0.5));
+  SHEFixed<I,F> r(x - k*M_PI_2);
+  SHEFixed<I,F> r2(r*r);
+  // sin(r) = r*P(r^2), cos(r) = Q(r^2)
+  static const SHEPolynomial sinPoly = SHEPolynomial::chebyshev(
+      [](shemaxfloat_t u) { return (shemaxfloat_t)(std::sin(std::sqrt(u))/
+                                                   std::sqrt(u)); },
+      SHEMATH_TRIG_LOOP_COUNT, 0.0, M_PI_4*M_PI_4);
+  static const SHEPolynomial cosPoly = SHEPolynomial::chebyshev(
+      [](shemaxfloat_t u) { return (shemaxfloat_t)std::cos(std::sqrt(u)); },
+      SHEMATH_TRIG_LOOP_COUNT, 0.0, M_PI_4*M_PI_4);
+  shemaxfloat_t epsilon = sheFixedEpsilon(x);
+  SHEFixed<I,F> s(r*sinPoly.trim(epsilon).evaluate(r2));
+  SHEFixed<I,F> c(cosPoly.trim(epsilon).evaluate(r2));
+  SHEInt b0(k.getValue().getBit(F));
+  SHEInt b1(k.getValue().getBit(F+1));
+  if (sinOut) {
+    SHEFixed<I,F> result(select(b0, c, s));
+    *sinOut = select(b1, -result, result);
+  }
+  if (cosOut) {
+    SHEFixed<I,F> result(select(b0, s, c));
+    *cosOut = select(b0 ^ b1, -result, result);
+  }
+}
+template<int I, int F>
+inline SHEFixed<I,F> sin(const SHEFixed<I,F> &x)
+{ SHEFixed<I,F> result(x); sheFixedSinCos<I,F>(x, &result, nullptr);
+  return result; }
+template<int I, int F>
+inline SHEFixed<I,F> cos(const SHEFixed<I,F> &x)
+{ SHEFixed<I,F> result(x); sheFixedSinCos<I,F>(x, nullptr, &result);
+  return result; }
+template<int I, int F>
+inline SHEFixed<I,F> tan(const SHEFixed<I,F> &x)
+{ SHEFixed<I,F> s(x), c(x); sheFixedSinCos(x, &s, &c); return s/c; }
+template<int I, int F>
+inline void sincos(const SHEFixed<I,F> &x, SHEFixed<I,F> &sinOut,
+                   SHEFixed<I,F> &cosOut)
+{ sheFixedSinCos(x, &sinOut, &cosOut); }
+#endif
@@ -7,11 +7,14 @@
 #include "SHETime.h"
 #include "SHEVector.h"
 #include "SHEFp.h"
+#include "SHEFixed.h"
 #include "SHEMath.h"
+#include "SHELinear.h"
 #include "getopt.h"
 
-#define NUM_TESTS 15
-#define FLOAT_TESTS 57
+#define NUM_TESTS 17
+#define FLOAT_TESTS 63
+#define FIXED_TESTS 11
 
 
 static struct option longOptions[] =
@@ -33,6 +36,7 @@ uint64_t ftohex(double a) { uint64_t *ap = (uint64_t*)&a; return *ap; }
                            (std::isinf(f) && std::isinf(g)) || \
                            (fabs(g) < F_epsilon ? fabs(f) < F_epsilon : \
                             fabs(((f)-(g))/(g)) < F_epsilon)))
+#define FIXED_CMP_EQ(f,g) (fabs((f)-(g)) < X_epsilon)
 
 #define RUN_TEST_ALIAS(target, expected, test, ptest) \
   std::cout << " calculating "#ptest \
@@ -56,6 +60,7 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
 {
   int16_t r[NUM_TESTS];
   float fr[FLOAT_TESTS];
+  double xr[FIXED_TESTS];
   Timer timer;
 
 
@@ -77,6 +82,9 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
 #else
   SHEVector<SHEFloat> efr(efa,FLOAT_TESTS);
 #endif
+  SHEFixed32 exb(pubkey,fb,"xb");
+  SHEFixed32 exc(pubkey,fc,"xc");
+  SHEVector<SHEFixed32> exr(exb,FIXED_TESTS);
   timer.stop();
   std::cout << " encrypt time = " << timer.elapsedMilliseconds()
             << " ms" << std::endl;
@@ -179,6 +187,26 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
   fr[53] = y0f(fa);
   fr[54] = y1f(fa);
   fr[55] = ynf(a, fa);
+  fr[57] = 1.0f/sqrtf(fa);
+  fr[58] = sinf(fa);
+  fr[59] = cosf(fa);
+  fr[60] = sinhf(fa);
+  fr[61] = coshf(fa);
+  fr[62] = powf(fa, a);
+  r[15] = (int16_t) powf(a, a);
+  r[16] = ((int16_t) powf(a+3, a)) % 7;
+  // fixed point operations
+  xr[0] = (double)fb*fc;
+  xr[1] = (double)fb/fc;
+  xr[2] = (double)fb*3.25;
+  xr[3] = sqrt((double)fb);
+  xr[4] = exp((double)fb);
+  xr[5] = log((double)fb);
+  xr[6] = log2((double)fb);
+  xr[7] = sin((double)fb);
+  xr[8] = cos((double)fb);
+  xr[9] = floor((double)fb);
+  xr[10] = fb;
   //Time the encrypted operations
   std::cout << "-------------- encrypted math tests"  << std::endl;
   std::cout << "..sign ints"  << std::endl;
@@ -251,9 +279,28 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
   RUN_TEST(efr[53], fr[53], efr[53] = y0(efa))
   RUN_TEST(efr[54], fr[54], efr[54] = y1(efa))
   RUN_TEST(efr[55], fr[55], efr[55] = yn(ea, efa))
+  RUN_TEST(efr[57], fr[57], efr[57] = rsqrt(efa))
+  RUN_TEST(efr[59], fr[59], sincos(efa, efr[58], efr[59]))
+  RUN_TEST(efr[61], fr[61], sinhcosh(efa, efr[60], efr[61]))
+  RUN_TEST(efr[62], fr[62], efr[62] = pow(efa, ea))
+  RUN_TEST(er[15], r[15], er[15] = pow(ea, ea))
+  RUN_TEST(er[16], r[16], er[16] = modpow(ea+3, ea, 7))
+  std::cout << "..fixed point"  << std::endl;
+  RUN_TEST(exr[0], xr[0], exr[0] = exb * exc)
+  RUN_TEST(exr[1], xr[1], exr[1] = exb / exc)
+  RUN_TEST(exr[2], xr[2], exr[2] = exb * 3.25)
+  RUN_TEST(exr[3], xr[3], exr[3] = sqrt(exb))
+  RUN_TEST(exr[4], xr[4], exr[4] = exp(exb))
+  RUN_TEST(exr[5], xr[5], exr[5] = log(exb))
+  RUN_TEST(exr[6], xr[6], exr[6] = log2(exb))
+  RUN_TEST(exr[7], xr[7], exr[7] = sin(exb))
+  RUN_TEST(exr[8], xr[8], exr[8] = cos(exb))
+  RUN_TEST(exr[9], xr[9], exr[9] = floor(exb))
+  RUN_TEST(exr[10], xr[10], exr[10] = SHEFixed32(efb))
 
   int16_t dr[NUM_TESTS];
   float dfr[FLOAT_TESTS];
+  double dxr[FIXED_TESTS];
 
   std::cout << "-----------------------------decrypting results" << std::endl;
   timer.start();
@@ -267,6 +314,11 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
               << std::endl;
     dfr[i] = efr[i].decrypt(privkey);
   }
+  for (int i = 0; i < exr.size(); i++) {
+    std::cout << "exr[" << i << "].bitCapacity: " << exr[i].bitCapacity()
+              << std::endl;
+    dxr[i] = exr[i].decrypt(privkey);
+  }
   timer.stop();
   std::cout << " decrypt time = "
             << (PrintTime) timer.elapsedMilliseconds() << std::endl;
@@ -292,8 +344,188 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
     }
     tests++; std::cout << std::endl;
   }
+  for (int i = 0; i < FIXED_TESTS; i++) {
+    std::cout << "xr[" << i << "]=" << xr[i] << " dxr[" << i << "]="
+              << dxr[i] << " ";
+    if (FIXED_CMP_EQ(xr[i],dxr[i])) {
+      std::cout << "PASS";
+    } else {
+      failed++; std::cout <<"FAIL";
+    }
+    tests++; std::cout << std::endl;
+  }
+}
+
+
+// exp2 and the trig range reduction past the range of the default
+// toSHEInt conversion: overflow and underflow in half float, and large
+// arguments in bfloat16. bfloat16 only has 8 bits of precision, and
+// a/trigStep is rounded to that before the reduction, so the trig
+// results are only good to about a table step.
+#define RANGE_TESTS 6
+#define BF_epsilon .01
+#define BF_TRIG_epsilon .1
+
+void
+do_range_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
+               int &failed, int &tests)
+{
+  float fr[RANGE_TESTS];
+  float dfr[RANGE_TESTS];
+  double epsilon[RANGE_TESTS];
+  Timer timer;
+  float ha = 200.0, hb = -200.0;
+  float ba = 16.0, bb = 100.0, bc = 51.5;
+
+  fr[0] = exp2f(ha);
+  fr[1] = exp2f(hb);
+  fr[2] = exp2f(ba);
+  fr[3] = exp2f(bb);
+  fr[4] = sinf(bc);
+  fr[5] = cosf(bc);
+  epsilon[0] = epsilon[1] = F_epsilon;
+  epsilon[2] = epsilon[3] = BF_epsilon;
+  epsilon[4] = epsilon[5] = BF_TRIG_epsilon;
+
+  std::cout << "-------------- range tests"  << std::endl;
+  SHEHalfFloat eha(pubkey,ha,"ha");
+  SHEHalfFloat ehb(pubkey,hb,"hb");
+  SHEBFloat16 eba(pubkey,ba,"ba");
+  SHEBFloat16 ebb(pubkey,bb,"bb");
+  SHEBFloat16 ebc(pubkey,bc,"bc");
+  SHEHalfFloat ehr[2] = { eha, ehb };
+  SHEBFloat16 ebr[4] = { eba, eba, eba, eba };
+  RUN_TEST(ehr[0], fr[0], ehr[0] = exp2(eha))
+  RUN_TEST(ehr[1], fr[1], ehr[1] = exp2(ehb))
+  RUN_TEST(ebr[0], fr[2], ebr[0] = exp2(eba))
+  RUN_TEST(ebr[1], fr[3], ebr[1] = exp2(ebb))
+  RUN_TEST(ebr[2], fr[4], ebr[2] = sin(ebc))
+  RUN_TEST(ebr[3], fr[5], ebr[3] = cos(ebc))
+
+  for (int i = 0; i < 2; i++) {
+    dfr[i] = ehr[i].decrypt(privkey);
+  }
+  for (int i = 0; i < 4; i++) {
+    dfr[i+2] = ebr[i].decrypt(privkey);
+  }
+
+  std::cout << "-------------decrypted outputs verse originals\n" << std::endl;
+  for (int i = 0; i < RANGE_TESTS; i++) {
+    std::cout << "fr[" << i << "]=" << fr[i] << " dfr[" << i << "]="
+              << dfr[i] << " ";
+    bool pass;
+    if (std::isinf(fr[i]) || (fr[i] == 0.0)) {
+      pass = fr[i] == dfr[i];
+    } else if (i >= 4) {
+      pass = fabs(fr[i] - dfr[i]) < epsilon[i];
+    } else {
+      pass = fabs((fr[i] - dfr[i])/fr[i]) < epsilon[i];
+    }
+    if (pass) {
+      std::cout << "PASS";
+    } else {
+      failed++; std::cout <<"FAIL";
+    }
+    tests++; std::cout << std::endl;
+  }
 }
 
+// dot, matVec and matMul on fixed and floating point. x and y are the
+// rows of a 2x2 matrix. The plaintext weights are negative, which the
+// wide fixed point sums (past 64 bits for SHEFixed32) have to sign extend.
+#define LINEAR_TESTS 8
+
+template<class T>
+std::vector<T> linear_tests(const T &x0, const T &x1, const T &y0, const T &y1)
+{
+  SHEVector<T> x(x0, 2), y(y0, 2);
+  x[1] = x1;
+  y[1] = y1;
+  SHEMatrix<T> m = { x, y };
+  SHEPlainMatrix<shemaxfloat_t> pm = { { 1.0, -2.0 }, { -0.5, 3.0 } };
+  std::vector<T> result;
+  result.push_back(dot(x, y));
+  result.push_back(dot(x, std::vector<shemaxfloat_t>{ -3.0, 0.5 }));
+  SHEVector<T> v(matVec(pm, x));
+  result.push_back(v[0]);
+  result.push_back(v[1]);
+  SHEMatrix<T> mm(matMul(m, m));
+  result.push_back(mm[0][0]);
+  result.push_back(mm[0][1]);
+  result.push_back(mm[1][0]);
+  result.push_back(mm[1][1]);
+  return result;
+}
+
+void
+do_linear_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
+                int &failed, int &tests)
+{
+  double xr[LINEAR_TESTS];
+  double dxr[LINEAR_TESTS];
+  float dfr[LINEAR_TESTS];
+  Timer timer;
+  float x0 = 1.5, x1 = -2.25, y0 = 0.5, y1 = 4.0;
+
+  xr[0] = x0*y0 + x1*y1;
+  xr[1] = -3.0*x0 + 0.5*x1;
+  xr[2] = x0 - 2.0*x1;
+  xr[3] = -0.5*x0 + 3.0*x1;
+  xr[4] = x0*x0 + x1*y0;
+  xr[5] = x0*x1 + x1*y1;
+  xr[6] = y0*x0 + y1*y0;
+  xr[7] = y0*x1 + y1*y1;
+
+  std::cout << "-------------- linear algebra tests"  << std::endl;
+  SHEFixed32 exr0(pubkey,x0,"x0");
+  SHEFixed32 exr1(pubkey,x1,"x1");
+  SHEFixed32 eyr0(pubkey,y0,"y0");
+  SHEFixed32 eyr1(pubkey,y1,"y1");
+  std::vector<SHEFixed32> exr;
+  RUN_TEST(exr[0], xr[0], exr = linear_tests(exr0, exr1, eyr0, eyr1))
+#ifdef SHE_USE_HALF_FLOAT
+  SHEHalfFloat efx0(pubkey,x0,"x0");
+  SHEHalfFloat efx1(pubkey,x1,"x1");
+  SHEHalfFloat efy0(pubkey,y0,"y0");
+  SHEHalfFloat efy1(pubkey,y1,"y1");
+  std::vector<SHEHalfFloat> efr;
+#else
+  SHEFloat efx0(pubkey,x0,"x0");
+  SHEFloat efx1(pubkey,x1,"x1");
+  SHEFloat efy0(pubkey,y0,"y0");
+  SHEFloat efy1(pubkey,y1,"y1");
+  std::vector<SHEFloat> efr;
+#endif
+  RUN_TEST(efr[0], xr[0], efr = linear_tests(efx0, efx1, efy0, efy1))
+
+  for (int i = 0; i < LINEAR_TESTS; i++) {
+    dxr[i] = exr[i].decrypt(privkey);
+    dfr[i] = efr[i].decrypt(privkey);
+  }
+
+  std::cout << "-------------decrypted outputs verse originals\n" << std::endl;
+  for (int i = 0; i < LINEAR_TESTS; i++) {
+    std::cout << "xr[" << i << "]=" << xr[i] << " dxr[" << i << "]="
+              << dxr[i] << " ";
+    if (FIXED_CMP_EQ(xr[i],dxr[i])) {
+      std::cout << "PASS";
+    } else {
+      failed++; std::cout <<"FAIL";
+    }
+    tests++; std::cout << std::endl;
+  }
+  for (int i = 0; i < LINEAR_TESTS; i++) {
+    float fr = xr[i];
+    std::cout << "fr[" << i << "]=" << fr << " dfr[" << i << "]="
+              << dfr[i] << " ";
+    if (FLOAT_CMP_EQ(fr,dfr[i])) {
+      std::cout << "PASS";
+    } else {
+      failed++; std::cout <<"FAIL";
+    }
+    tests++; std::cout << std::endl;
+  }
+}
 
 int main(int argc, char **argv)
 {
@@ -359,6 +591,8 @@ int main(int argc, char **argv)
   fc = 1.23;
 
   do_tests(pubkey, privkey, a, fa, fb, fc, failed, tests);
+  do_range_tests(pubkey, privkey, failed, tests);
+  do_linear_tests(pubkey, privkey, failed, tests);
 
   std::cout << failed << " test" << (char *)((failed == 1) ? "" : "s")
             << " failed out of " << tests << " tests." << std::endl;
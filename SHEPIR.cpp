@@ -0,0 +1,239 @@
+//
+// private information retrieval over plaintext tables
+//
+#include <iostream>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <NTL/BasicThreadPool.h>
+#include "SHEPIR.h"
+#include "SHEInt.h"
+#include "SHEKey.h"
+#include "SHEVector.h"
+#include "SHEConfig.h"
+#include <helib/helib.h>
+
+std::ostream *SHEPIRTable::log = nullptr;
+
+SHEPIRTable::SHEPIRTable(const unsigned char *data_, uint64_t rows_,
+                         int recordSize_) :
+             rows(rows_), recordSize(recordSize_),
+             storage(data_, data_+rows_*recordSize_), map(nullptr),
+             mapSize(0), rowsPerSecond(0.0)
+{
+  data = storage.data();
+  checkSize();
+}
+
+SHEPIRTable::SHEPIRTable(const std::vector<uint64_t> &values,
+                         int recordSize_) :
+             rows(values.size()), recordSize(recordSize_), map(nullptr),
+             mapSize(0), rowsPerSecond(0.0)
+{
+  helib::assertTrue((recordSize > 0) && (recordSize <= 8),
+                    "integer records must be 1 to 8 bytes");
+  for (auto value : values) {
+    for (int i=0; i < recordSize; i++) {
+      storage.push_back((value >> (i*8)) & 0xff);
+    }
+  }
+  data = storage.data();
+  checkSize();
+}
+
+SHEPIRTable::SHEPIRTable(const char *file, int recordSize_) :
+             recordSize(recordSize_), map(nullptr), mapSize(0),
+             rowsPerSecond(0.0)
+{
+  struct stat info;
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) {
+    throw helib::IOError(std::string("can't open PIR table ") + file);
+  }
+  if (fstat(fd, &info) < 0) {
+    close(fd);
+    throw helib::IOError(std::string("can't stat PIR table ") + file);
+  }
+  if ((recordSize <= 0) || (info.st_size % recordSize != 0)) {
+    close(fd);
+    throw helib::LogicError("PIR table file isn't a whole number of records");
+  }
+  mapSize = info.st_size;
+  rows = mapSize/recordSize;
+  if (mapSize) {
+    map = mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    map = nullptr;
+    throw helib::IOError(std::string("can't map PIR table ") + file);
+  }
+  data = (const unsigned char *)map;
+  // the destructor won't run if we throw here
+  try {
+    checkSize();
+  } catch (...) {
+    if (map) {
+      munmap(map, mapSize);
+    }
+    throw;
+  }
+}
+
+SHEPIRTable::~SHEPIRTable(void)
+{
+  if (map) {
+    munmap(map, mapSize);
+  }
+}
+
+void SHEPIRTable::checkSize(void) const
+{
+  helib::assertTrue(rows > 0, "empty PIR table");
+  helib::assertTrue(recordSize > 0, "PIR records must have a size");
+  helib::assertTrue(getIndexBits() <= 2*SHEINT_MAX_DECODE_BITS,
+                    "PIR table has too many rows to decode");
+}
+
+int SHEPIRTable::getIndexBits(void) const
+{
+  int bits = 1;
+  while ((bits < 64) && ((rows-1) >> bits)) {
+    bits++;
+  }
+  return bits;
+}
+
+// The high rows are split across the NTL thread pool (SHEInt::setThreads()).
+// Each worker takes every workers'th high row into its own partial
+// response. The workers only touch helib ciphertexts, never SHEInts.
+std::vector<helib::Ctxt> SHEPIRTable::queryBits(const SHEInt &index) const
+{
+  int indexBits = getIndexBits();
+  int lowBits = (indexBits+1)/2;
+  int highBits = indexBits - lowBits;
+  int outputBits = getOutputBits();
+  const helib::PubKey &helibPubKey = index.getPublicKey().getPublicKey();
+  helib::Ctxt zero(helibPubKey);
+  zero.clear();
+
+  // decode both halves and bring them up to capacity together
+  SHEInt low(index);
+  low.reset(lowBits, true);
+  SHEInt high(index);
+  high >>= lowBits;
+  high.reset(std::max(highBits,1), true);
+  SHEVector<SHEInt> oneHot(low, 0);
+  for (auto &bit : low.decode()) {
+    oneHot.push_back(bit);
+  }
+  if (highBits) {
+    for (auto &bit : high.decode()) {
+      oneHot.push_back(bit);
+    }
+  }
+  oneHot.verifyArgs();
+  std::vector<helib::Ctxt> lo, hi;
+  std::vector<bool> loZero, hiZero;
+  for (int i=0; i < oneHot.size(); i++) {
+    bool isZero = oneHot[i].isUnencryptedZero();
+    helib::Ctxt bit(isZero ? zero : oneHot[i].getCtxt()[0]);
+    if (i < (1 << lowBits)) {
+      lo.push_back(bit);
+      loZero.push_back(isZero);
+    } else {
+      hi.push_back(bit);
+      hiZero.push_back(isZero);
+    }
+  }
+
+  uint64_t highRows = (rows + (1ULL << lowBits) - 1) >> lowBits;
+  long workers = (long)std::min((uint64_t)NTL::AvailableThreads(), highRows);
+  std::vector<std::vector<helib::Ctxt>> partial(workers,
+                            std::vector<helib::Ctxt>(outputBits, zero));
+  NTL_EXEC_RANGE(workers, first, last)
+  for (long worker=first; worker < last; worker++) {
+    std::vector<helib::Ctxt> &acc = partial[worker];
+    for (uint64_t h=worker; h < highRows; h += workers) {
+      if (highBits && hiZero[h]) {
+        continue;
+      }
+      std::vector<helib::Ctxt> masked(outputBits, zero);
+      std::vector<bool> used(outputBits, false);
+      for (uint64_t l=0; l < lo.size(); l++) {
+        uint64_t row = (h << lowBits) + l;
+        if ((row >= rows) || loZero[l]) {
+          continue;
+        }
+        for (int j=0; j < outputBits; j++) {
+          if (getTableBit(row, j)) {
+            masked[j] += lo[l];
+            used[j] = true;
+          }
+        }
+      }
+      for (int j=0; j < outputBits; j++) {
+        if (!used[j]) {
+          continue;
+        }
+        if (highBits) {
+          masked[j].multiplyBy(hi[h]);
+        }
+        acc[j] += masked[j];
+      }
+    }
+  }
+  NTL_EXEC_RANGE_END
+  for (long worker=1; worker < workers; worker++) {
+    for (int j=0; j < outputBits; j++) {
+      partial[0][j] += partial[worker][j];
+    }
+  }
+  return partial[0];
+}
+
+SHEInt SHEPIRTable::toSHEInt(const SHEInt &model,
+                             const std::vector<helib::Ctxt> &bits,
+                             int low, int count) const
+{
+  return SHEInt(model.getPublicKey(),
+                std::vector<helib::Ctxt>(bits.begin()+low,
+                                         bits.begin()+low+count), true);
+}
+
+std::vector<SHEUInt8> SHEPIRTable::query(const SHEInt &index) const
+{
+  if (log) {
+    (*log) << "PIR query(" << (SHEIntSummary)index << ") rows=" << rows
+           << " recordSize=" << recordSize << std::endl;
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::vector<helib::Ctxt> bits(queryBits(index));
+  std::vector<SHEUInt8> record;
+  for (int i=0; i < recordSize; i++) {
+    record.push_back(SHEUInt8(toSHEInt(index, bits, i*8, 8)));
+  }
+  std::chrono::duration<double> elapsed =
+                                  std::chrono::steady_clock::now() - start;
+  rowsPerSecond = elapsed.count() > 0.0 ? rows/elapsed.count() : 0.0;
+  return record;
+}
+
+SHEInt SHEPIRTable::queryInt(const SHEInt &index) const
+{
+  helib::assertTrue(recordSize <= 8,
+                    "PIR records over 8 bytes must use query()");
+  if (log) {
+    (*log) << "PIR queryInt(" << (SHEIntSummary)index << ") rows=" << rows
+           << " recordSize=" << recordSize << std::endl;
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::vector<helib::Ctxt> bits(queryBits(index));
+  SHEInt result(toSHEInt(index, bits, 0, getOutputBits()));
+  std::chrono::duration<double> elapsed =
+                                  std::chrono::steady_clock::now() - start;
+  rowsPerSecond = elapsed.count() > 0.0 ? rows/elapsed.count() : 0.0;
+  return result;
+}
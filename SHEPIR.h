@@ -0,0 +1,82 @@
+//
+// private information retrieval: look up a row of a plaintext table with
+// an encrypted index
+//
+#ifndef SHEPIR_H_
+#define SHEPIR_H_ 1
+#include <cstdint>
+#include <iostream>
+#include <atomic>
+#include <vector>
+#include "SHEInt.h"
+
+//
+// The server holds a plaintext table of fixed size records, the client
+// sends an encrypted row number and gets back the encrypted record. The
+// server learns nothing about which row was read.
+//
+// The index is split into a high and a low half, each is decoded once into
+// one hot bits (see SHEInt::decode()). Bit j of the response is then
+//
+//   XOR over h of hi[h] & (XOR of lo[l] for each row (h,l) with bit j set)
+//
+// The inner XORs are sums masked by the plaintext table, which cost a
+// ciphertext add and no depth. So a query is two decodes of half the index
+// bits, one AND for each high row and output bit, and one add for each
+// set bit in the table, rather than an equality compare on every row. The
+// high rows are split across the NTL thread pool (SHEInt::setThreads()),
+// and the partial responses are XORed together at the end.
+//
+// Tables can be built from memory, or memory mapped from a file of records
+// so that large tables are paged in from disk as they are read. Rows past
+// the end of the table read as zero, and index bits above getIndexBits()
+// are ignored.
+//
+class SHEPIRTable {
+private:
+  static std::ostream *log;
+  uint64_t rows;
+  int recordSize;                      // bytes per row
+  std::vector<unsigned char> storage;  // tables built in memory
+  void *map;                           // memory mapped tables
+  size_t mapSize;
+  const unsigned char *data;
+  // queries on one table can run in separate threads
+  mutable std::atomic<double> rowsPerSecond;
+
+  int getOutputBits(void) const { return recordSize*8; }
+  bool getTableBit(uint64_t row, int bit) const
+  { return (data[row*recordSize + bit/8] >> (bit%8)) & 1; }
+  void checkSize(void) const;
+  std::vector<helib::Ctxt> queryBits(const SHEInt &index) const;
+  SHEInt toSHEInt(const SHEInt &model, const std::vector<helib::Ctxt> &bits,
+                  int low, int count) const;
+
+public:
+  // copies rows*recordSize bytes of records
+  SHEPIRTable(const unsigned char *data_, uint64_t rows_, int recordSize_);
+  // each value is stored little endian in recordSize bytes
+  SHEPIRTable(const std::vector<uint64_t> &values, int recordSize_);
+  // map the file, which is a whole number of records
+  SHEPIRTable(const char *file, int recordSize_);
+  SHEPIRTable(const SHEPIRTable &) = delete;
+  SHEPIRTable &operator=(const SHEPIRTable &) = delete;
+  ~SHEPIRTable(void);
+
+  // accessor functions
+  uint64_t getRows(void) const { return rows; }
+  int getRecordSize(void) const { return recordSize; }
+  int getIndexBits(void) const;
+  // throughput of the most recently finished query
+  double getRowsPerSecond(void) const { return rowsPerSecond.load(); }
+
+  // the record as encrypted bytes
+  std::vector<SHEUInt8> query(const SHEInt &index) const;
+  // the record as one unsigned little endian integer, recordSize <= 8
+  SHEInt queryInt(const SHEInt &index) const;
+
+  static void setLog(std::ostream &str) { log = &str; }
+  static void clearLog(void) { log = nullptr; }
+};
+
+#endif
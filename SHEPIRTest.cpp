@@ -0,0 +1,205 @@
+//
+// Test program for private information retrieval
+//
+#include <iostream>
+#include <string>
+#include "SHEKey.h"
+#include "SHEInt.h"
+#include "SHETime.h"
+#include "SHEPIR.h"
+#include "getopt.h"
+
+static struct option longOptions[] =
+{
+   // options
+   { "security-level", required_argument, 0, 's' },
+   { "capacity", required_argument, 0, 'c' },
+   { "threads", required_argument, 0, 't' },
+   { "file", required_argument, 0, 'f' },
+   { "record-size", required_argument, 0, 'r' },
+   { "index", required_argument, 0, 'i' },
+   { 0, 0, 0, 0 }
+};
+
+static const char *countries[] = {
+  "Argentina", "Australia", "Austria", "Belgium", "Brazil", "Canada",
+  "Chile", "China", "Denmark", "Egypt", "Finland", "France", "Germany",
+  "Greece", "India", "Ireland", "Israel", "Italy", "Japan", "Kenya",
+  "Mexico", "Norway", "Peru", "Poland", "Portugal", "Spain", "Sweden",
+  "Turkey", "Ukraine", "Uruguay"
+};
+#define COUNTRY_COUNT (sizeof(countries)/sizeof(countries[0]))
+#define COUNTRY_SIZE 12
+
+static void
+report(const char *name, const SHEPIRTable &table, Timer &timer)
+{
+  std::cout << " " << name << " rows=" << table.getRows()
+            << " recordSize=" << table.getRecordSize()
+            << " threads=" << SHEInt::getThreads()
+            << " time = " << (PrintTime) timer.elapsedMilliseconds()
+            << " rows/second = " << table.getRowsPerSecond() << std::endl;
+}
+
+static void
+check(const char *name, uint64_t index, const std::string &expected,
+      const std::string &result, int &failed, int &tests)
+{
+  std::cout << " " << name << "[" << index << "] \"" << expected
+            << "\" =? \"" << result << "\" ";
+  if (expected == result) {
+    std::cout << "PASS";
+  } else {
+    failed++;
+    std::cout << "FAIL";
+  }
+  tests++; std::cout << std::endl;
+}
+
+static std::string
+decryptRecord(const std::vector<SHEUInt8> &record, SHEPrivateKey &privkey)
+{
+  std::string result;
+  for (auto &byte : record) {
+    char c = (char)byte.decrypt(privkey);
+    if (c == 0) {
+      break;
+    }
+    result.push_back(c);
+  }
+  return result;
+}
+
+void
+do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
+         uint64_t index, int &failed, int &tests)
+{
+  Timer timer;
+
+  // integer table
+  std::vector<uint64_t> squares;
+  for (uint64_t i=0; i < 300; i++) {
+    squares.push_back((i*i+7) & 0xffff);
+  }
+  SHEPIRTable squareTable(squares, 2);
+  uint64_t row = index % squares.size();
+  SHEUInt16 eindex(pubkey, (uint16_t)row, "index");
+  timer.start();
+  SHEInt eresult = squareTable.queryInt(eindex);
+  timer.stop();
+  report("squares", squareTable, timer);
+  check("squares", row, std::to_string(squares[row]),
+        std::to_string(eresult.decryptRaw(privkey)), failed, tests);
+
+  // record table
+  std::vector<unsigned char> names(COUNTRY_COUNT*COUNTRY_SIZE, 0);
+  for (int i=0; i < COUNTRY_COUNT; i++) {
+    std::string name(countries[i]);
+    std::copy(name.begin(), name.end(), names.begin()+i*COUNTRY_SIZE);
+  }
+  SHEPIRTable countryTable(names.data(), COUNTRY_COUNT, COUNTRY_SIZE);
+  row = index % COUNTRY_COUNT;
+  SHEUInt8 ecountry(pubkey, (uint8_t)row, "country");
+  timer.start();
+  std::vector<SHEUInt8> record = countryTable.query(ecountry);
+  timer.stop();
+  report("countries", countryTable, timer);
+  check("countries", row, countries[row], decryptRecord(record, privkey),
+        failed, tests);
+
+  // rows past the end of the table read as zero
+  SHEUInt8 epast(pubkey, (uint8_t)COUNTRY_COUNT, "past");
+  record = countryTable.query(epast);
+  check("countries", COUNTRY_COUNT, "", decryptRecord(record, privkey),
+        failed, tests);
+}
+
+// query a mapped file, there's no expected value so just report the
+// record and the throughput
+void
+do_file(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
+        const char *file, int recordSize, uint64_t index)
+{
+  Timer timer;
+  SHEPIRTable table(file, recordSize);
+  SHEUInt64 eindex(pubkey, index, "index");
+  timer.start();
+  std::vector<SHEUInt8> record = table.query(eindex);
+  timer.stop();
+  report(file, table, timer);
+  std::cout << " " << file << "[" << index << "] =";
+  for (auto &byte : record) {
+    std::cout << " " << (int)byte.decrypt(privkey);
+  }
+  std::cout << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  SHEPublicKey pubkey;
+  SHEPrivateKey privkey;
+  int failed = 0;
+  int tests = 0;
+  long securityLevel = 19;
+  long capacity = SHE_CONTEXT_CAPACITY_ANY;
+  const char *file = nullptr;
+  int recordSize = 1;
+  uint64_t index = 17;
+  int threads = 0;
+  const char *argString="s:c:t:f:r:i:";
+
+  int carg;
+
+  while(1) {
+    int optionIndex=0;
+    carg = getopt_long(argc, argv, argString,
+                       longOptions, &optionIndex);
+    if (carg == -1) break;
+    switch (carg) {
+    case 's':
+      securityLevel = atoi(optarg);
+      break;
+    case 'c':
+      capacity = atoi(optarg);
+      break;
+    case 't':
+      threads = atoi(optarg);
+      break;
+    case 'f':
+      file = optarg;
+      break;
+    case 'r':
+      recordSize = atoi(optarg);
+      break;
+    case 'i':
+      index = strtoull(optarg, nullptr, 0);
+      break;
+    default:
+      break;
+    }
+  }
+
+  // the query splits its rows across the SHEInt thread pool
+  SHEInt::setThreads(threads);
+  SHEGenerate_BinaryKey(privkey, pubkey, securityLevel, capacity);
+#ifdef DEBUG
+  SHEInt::setDebugPrivateKey(privkey);
+#endif
+
+  if (file) {
+    do_file(pubkey, privkey, file, recordSize, index);
+    return 0;
+  }
+  do_tests(pubkey, privkey, index, failed, tests);
+  SHEInt::setThreads(1);
+  do_tests(pubkey, privkey, index+100, failed, tests);
+
+  std::cout << failed << " test" << (char *)((failed == 1) ? "" : "s")
+            << " failed out of " << tests << " tests." << std::endl;
+  if (failed) {
+    std::cout << "FAILED" << std::endl;
+  } else {
+    std::cout << "PASSED" << std::endl;
+  }
+  return failed;
+}
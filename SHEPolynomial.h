@@ -0,0 +1,277 @@
+//
+// evaluate polynomials with plaintext coefficients on encrypted values
+//
+#ifndef SHEPolynomial_H_
+#define SHEPolynomial_H_ 1
+#include <cmath>
+#include <vector>
+#include <functional>
+#include "SHEFp.h"
+
+//
+// The coefficients are plaintext, so multiplying by them is a scalar
+// multiply. The encrypted by encrypted multiplies are the expensive ones,
+// and the ones that eat depth. evaluate() uses baby-step/giant-step
+// (Paterson-Stockmeyer): it builds x^1..x^k (or T_1..T_k) once, along with
+// the giant powers x^k, x^2k, x^4k,..., then splits the polynomial on the
+// giant powers recursively. A degree d polynomial takes about
+// 2*sqrt(d)+log2(d) encrypted multiplies rather than the d of horner's rule
+// or the 2d of a term by term taylor loop, and the depth is O(log d)
+// rather than O(d).
+//
+// Chebyshev polynomials are defined on a domain [lo,hi], which is mapped
+// to [-1,1] before evaluation. A chebyshev fit is close to the minimax
+// polynomial for a given degree, so it needs fewer terms than a taylor
+// series for the same accuracy. Outside the domain the result is garbage.
+// The domain of a monomial polynomial is only used by trim().
+//
+// T can be any encrypted type with T*T, T+T, T-T, T*shemaxfloat_t,
+// T+shemaxfloat_t and a T(const T &model, shemaxfloat_t) constructor
+// (SHEFp and subclasses, SHEFixed).
+//
+enum SHEPolyBasis {
+  SHEPolyMonomial,
+  SHEPolyChebyshev
+};
+
+class SHEPolynomial {
+private:
+  std::vector<shemaxfloat_t> coeff;
+  SHEPolyBasis basis;
+  shemaxfloat_t lo;
+  shemaxfloat_t hi;
+
+  static int getDegree(const std::vector<shemaxfloat_t> &c)
+  {
+    int degree = c.size()-1;
+    while ((degree > 0) && (c[degree] == 0.0)) {
+      degree--;
+    }
+    return degree;
+  }
+  // x^n or T_n from x^a*x^b or T_a*T_b, where a+b=n
+  template<class T>
+  T combine(const T &x, const T &a, const T &b, int diff) const
+  {
+    T result(a*b);
+    if (basis == SHEPolyMonomial) {
+      return result;
+    }
+    // T_(a+b) = 2*T_a*T_b - T_|a-b|
+    result = result + result;
+    if (diff == 0) {
+      return result - 1.0;
+    }
+    return result - x;
+  }
+  // evaluate c using the baby powers and the giant powers up to level
+  template<class T>
+  T evaluateSplit(const std::vector<shemaxfloat_t> &c, const T &x,
+                  const std::vector<T> &power, const std::vector<T> &giant)
+                  const
+  {
+    int k = power.size()-1;
+    int degree = getDegree(c);
+    if (degree <= k) {
+      // baby step, scalar multiplies only
+      T result(x, c[0]);
+      bool first = true;
+      for (int i=1; i <= degree; i++) {
+        if (c[i] == 0.0) {
+          continue;
+        }
+        T term(power[i]*c[i]);
+        result = first ? term : result + term;
+        first = false;
+      }
+      if (!first && (c[0] != 0.0)) {
+        result = result + c[0];
+      }
+      return result;
+    }
+    // giant step, split on the largest giant power that fits
+    int level = 0;
+    while ((level+1 < giant.size()) && ((k << (level+1)) <= degree)) {
+      level++;
+    }
+    int m = k << level;
+    std::vector<shemaxfloat_t> low(c.begin(), c.begin()+m);
+    std::vector<shemaxfloat_t> high(c.begin()+m, c.begin()+degree+1);
+    if (basis == SHEPolyChebyshev) {
+      // T_i = 2*T_m*T_(i-m) - T_(2m-i) for m < i < 2m
+      for (int i=m+1; i <= degree; i++) {
+        high[i-m] = 2.0*c[i];
+        low[2*m-i] -= c[i];
+      }
+    }
+    T result(evaluateSplit(high, x, power, giant)*giant[level]);
+    if (getDegree(low) == 0 && low[0] == 0.0) {
+      return result;
+    }
+    return result + evaluateSplit(low, x, power, giant);
+  }
+
+  // map the chebyshev domain onto [-1,1]
+  template<class T>
+  T mapDomain(const T &xin) const
+  {
+    T x(xin);
+    if ((basis == SHEPolyChebyshev) && ((lo != -1.0) || (hi != 1.0))) {
+      x = xin*(2.0/(hi-lo));
+      if (hi+lo != 0.0) {
+        x = x - (hi+lo)/(hi-lo);
+      }
+    }
+    return x;
+  }
+  // baby steps x^1..x^k and giant steps x^k, x^2k, x^4k... for a
+  // polynomial of the given degree
+  template<class T>
+  void buildPowers(const T &x, int degree, std::vector<T> &power,
+                   std::vector<T> &giant) const
+  {
+    int k = std::min(degree, (int)std::ceil(std::sqrt((double)degree+1)));
+    power.assign(1, x);
+    power.push_back(x);
+    for (int i=2; i <= k; i++) {
+      int a = i/2;
+      power.push_back(combine(x, power[a], power[i-a], i-2*a));
+    }
+    giant.assign(1, power[k]);
+    while ((k << giant.size()) <= degree) {
+      giant.push_back(combine(x, giant.back(), giant.back(), 0));
+    }
+  }
+
+public:
+  SHEPolynomial(const std::vector<shemaxfloat_t> &coeff_,
+                SHEPolyBasis basis_=SHEPolyMonomial,
+                shemaxfloat_t lo_=-1.0, shemaxfloat_t hi_=1.0) :
+                coeff(coeff_), basis(basis_), lo(lo_), hi(hi_)
+  { if (coeff.size() == 0) coeff.push_back(0.0); }
+  SHEPolynomial(const SHEPolynomial &a) : coeff(a.coeff), basis(a.basis),
+                lo(a.lo), hi(a.hi) {}
+
+  // build the chebyshev interpolant of f on [lo,hi]
+  static SHEPolynomial chebyshev(
+                    const std::function<shemaxfloat_t(shemaxfloat_t)> &f,
+                    int degree, shemaxfloat_t lo=-1.0, shemaxfloat_t hi=1.0)
+  {
+    int n = degree+1;
+    std::vector<shemaxfloat_t> fx(n);
+    std::vector<shemaxfloat_t> c(n);
+    for (int k=0; k < n; k++) {
+      shemaxfloat_t node = std::cos(M_PI*(k+0.5)/n);
+      fx[k] = f(node*(hi-lo)/2.0 + (hi+lo)/2.0);
+    }
+    for (int j=0; j < n; j++) {
+      shemaxfloat_t sum = 0.0;
+      for (int k=0; k < n; k++) {
+        sum += fx[k]*std::cos(M_PI*j*(k+0.5)/n);
+      }
+      c[j] = sum*2.0/n;
+    }
+    c[0] /= 2.0;
+    return SHEPolynomial(c, SHEPolyChebyshev, lo, hi);
+  }
+  // drop the high order terms that together can't change the result over
+  // the domain by more than epsilon.
+  SHEPolynomial trim(shemaxfloat_t epsilon) const
+  {
+    shemaxfloat_t xmax = 1.0;
+    if (basis == SHEPolyMonomial) {
+      xmax = std::max(shemaxfloat_abs(lo), shemaxfloat_abs(hi));
+    }
+    int degree = getDegree(coeff);
+    shemaxfloat_t dropped = 0.0;
+    while (degree > 0) {
+      dropped += shemaxfloat_abs(coeff[degree])*
+                 shemaxfloat_pow(xmax, degree);
+      if (dropped >= epsilon) {
+        break;
+      }
+      degree--;
+    }
+    std::vector<shemaxfloat_t> c(coeff.begin(), coeff.begin()+degree+1);
+    return SHEPolynomial(c, basis, lo, hi);
+  }
+
+  // accessor functions
+  int getDegree(void) const { return getDegree(coeff); }
+  SHEPolyBasis getBasis(void) const { return basis; }
+  const std::vector<shemaxfloat_t> &getCoefficients(void) const
+  { return coeff; }
+  shemaxfloat_t getLow(void) const { return lo; }
+  shemaxfloat_t getHigh(void) const { return hi; }
+
+  // unencrypted evaluation, horner or clenshaw
+  shemaxfloat_t evaluate(shemaxfloat_t x) const
+  {
+    int degree = getDegree();
+    if (basis == SHEPolyMonomial) {
+      shemaxfloat_t result = coeff[degree];
+      for (int i=degree-1; i >= 0; i--) {
+        result = result*x + coeff[i];
+      }
+      return result;
+    }
+    x = (2.0*x - (hi+lo))/(hi-lo);
+    shemaxfloat_t b1 = 0.0, b2 = 0.0;
+    for (int i=degree; i > 0; i--) {
+      shemaxfloat_t b0 = 2.0*x*b1 - b2 + coeff[i];
+      b2 = b1;
+      b1 = b0;
+    }
+    return x*b1 - b2 + coeff[0];
+  }
+
+  template<class T>
+  T evaluate(const T &xin) const
+  {
+    if (getDegree() == 0) {
+      return T(xin, coeff[0]);
+    }
+    std::vector<T> power, giant;
+    T x(mapDomain(xin));
+    buildPowers(x, getDegree(), power, giant);
+    return evaluateSplit(coeff, x, power, giant);
+  }
+  // evaluate several polynomials in the same variable, sharing the baby
+  // and giant power tables between them. The polynomials must have the
+  // same basis and domain.
+  template<class T>
+  static std::vector<T> evaluate(const std::vector<SHEPolynomial> &polys,
+                                 const T &xin)
+  {
+    std::vector<T> result;
+    if (polys.size() == 0) {
+      return result;
+    }
+    const SHEPolynomial &first = polys[0];
+    int degree = 0;
+    for (auto &poly : polys) {
+      helib::assertTrue((poly.basis == first.basis) &&
+                        (poly.lo == first.lo) && (poly.hi == first.hi),
+                        "shared polynomial evaluation needs a common basis"
+                        " and domain");
+      degree = std::max(degree, poly.getDegree());
+    }
+    std::vector<T> power, giant;
+    T x(first.mapDomain(xin));
+    if (degree > 0) {
+      first.buildPowers(x, degree, power, giant);
+    }
+    for (auto &poly : polys) {
+      if (poly.getDegree() == 0) {
+        result.push_back(T(xin, poly.coeff[0]));
+        continue;
+      }
+      result.push_back(poly.evaluateSplit(poly.coeff, x, power, giant));
+    }
+    return result;
+  }
+  template<class T>
+  T operator()(const T &x) const { return evaluate(x); }
+};
+
+#endif
@@ -0,0 +1,329 @@
+//
+// a small SQL like query layer over encrypted columns
+//
+#include <iostream>
+#include <NTL/BasicThreadPool.h>
+#include "SHEQuery.h"
+#include "SHEInt.h"
+#include "SHEKey.h"
+#include "SHEVector.h"
+#include "SHEAlgorithm.h"
+#include <helib/helib.h>
+
+std::ostream *SHEQuery::log = nullptr;
+
+void SHETable::addColumn(const std::string &name,
+                         const SHEVector<SHEInt> &column)
+{
+  helib::assertTrue(!hasColumn(name), "duplicate column " + name);
+  helib::assertTrue(column.size() > 0, "empty column " + name);
+  helib::assertTrue((columns.size() == 0) || (column.size() == getRows()),
+                    "columns must all have the same number of rows");
+  names.push_back(name);
+  columns.push_back(column);
+}
+
+bool SHETable::hasColumn(const std::string &name) const
+{
+  for (auto &columnName : names) {
+    if (columnName == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const SHEVector<SHEInt> &SHETable::getColumn(const std::string &name) const
+{
+  for (int i=0; i < names.size(); i++) {
+    if (names[i] == name) {
+      return columns[i];
+    }
+  }
+  throw helib::LogicError("no column " + name);
+}
+
+const SHEPublicKey &SHETable::getPublicKey(void) const
+{
+  helib::assertTrue(columns.size() > 0, "table has no columns");
+  return columns[0][0].getPublicKey();
+}
+
+SHEQuery &SHEQuery::select(SHEQueryAggregate aggregate,
+                           const std::string &column)
+{
+  helib::assertTrue((aggregate == SHEQueryCount) || table.hasColumn(column),
+                    "select of unknown column " + column);
+  selects.push_back({aggregate, column});
+  return *this;
+}
+
+// where value falls against the range of model's type: -1 below it,
+// 1 above it, 0 in it
+static int rangeCheck(const SHEInt &model, int64_t value)
+{
+  int size = model.getSize();
+  if (model.getUnsigned()) {
+    if (value < 0) {
+      return -1;
+    }
+    return ((size < 64) && ((uint64_t)value >> size)) ? 1 : 0;
+  }
+  if (size >= 64) {
+    return 0;
+  }
+  int64_t limit = 1LL << (size-1);
+  return (value < -limit) ? -1 : (value >= limit) ? 1 : 0;
+}
+
+SHEQuery &SHEQuery::where(const std::string &column, SHEQueryOp op,
+                          int64_t value)
+{
+  helib::assertTrue(table.hasColumn(column),
+                    "where on unknown column " + column);
+  if (whereFalse) {
+    return *this;
+  }
+  // a constant outside the column's range decides the condition in the
+  // clear, and would be truncated if it were encrypted at the column's size
+  int range = rangeCheck(table.getColumn(column)[0], value);
+  if (range) {
+    bool alwaysTrue = (op == SHEQueryNE) ||
+        ((range < 0) ? ((op == SHEQueryGT) || (op == SHEQueryGE))
+                     : ((op == SHEQueryLT) || (op == SHEQueryLE)));
+    if (!alwaysTrue) {
+      whereFalse = true;
+      conditions.clear();
+    }
+    return *this;
+  }
+  SHEQueryCondition condition = {column, op, value};
+  for (auto &existing : conditions) {
+    if (existing == condition) {
+      return *this;
+    }
+  }
+  conditions.push_back(condition);
+  return *this;
+}
+
+SHEQuery &SHEQuery::groupBy(const std::string &column,
+                            const std::vector<int64_t> &groups_)
+{
+  helib::assertTrue(table.hasColumn(column),
+                    "group by unknown column " + column);
+  helib::assertTrue(groups_.size() > 0, "group by needs at least one group");
+  groupColumn = column;
+  groups = groups_;
+  // keys outside the column's range keep their place in the result, but
+  // no row can match them
+  const SHEInt &model = table.getColumn(column)[0];
+  groupInRange.clear();
+  for (auto group : groups) {
+    groupInRange.push_back(rangeCheck(model, group) == 0);
+  }
+  return *this;
+}
+
+static SHEInt compare(const SHEInt &value, SHEQueryOp op,
+                      const SHEInt &constant)
+{
+  switch (op) {
+  case SHEQueryEQ: return value == constant;
+  case SHEQueryNE: return value != constant;
+  case SHEQueryLT: return value < constant;
+  case SHEQueryLE: return value <= constant;
+  case SHEQueryGT: return value > constant;
+  case SHEQueryGE: return value >= constant;
+  }
+  throw helib::LogicError("unknown query comparison");
+}
+
+// stage 1 and 2 of the plan, the row masks for each group, flattened
+// group by group
+std::vector<SHEInt> SHEQuery::rowMasks(void) const
+{
+  size_t rows = table.getRows();
+  helib::assertTrue(rows > 0, "query on an empty table");
+  const SHEPublicKey &pubKey = table.getPublicKey();
+  SHEInt zero(pubKey, (uint64_t)0, 1, true);
+  size_t groupCount = groups.size() ? groups.size() : 1;
+  if (whereFalse) {
+    return std::vector<SHEInt>(groupCount*rows, zero);
+  }
+
+  // stage 1: each condition and group compare on each row. Each column
+  // that is compared is brought up to capacity once.
+  std::vector<std::string> used;
+  std::vector<SHEVector<SHEInt>> inputs;
+  inputs.reserve(conditions.size()+1);
+  auto input = [&](const std::string &name) -> const SHEVector<SHEInt> & {
+    for (int i=0; i < used.size(); i++) {
+      if (used[i] == name) {
+        return inputs[i];
+      }
+    }
+    used.push_back(name);
+    inputs.push_back(table.getColumn(name));
+    inputs.back().verifyArgs();
+    return inputs.back();
+  };
+  struct SHEQueryCompare {
+    const SHEVector<SHEInt> *column;
+    SHEQueryOp op;
+    SHEInt constant;
+  };
+  std::vector<SHEQueryCompare> compares;
+  for (auto &condition : conditions) {
+    const SHEVector<SHEInt> &column = input(condition.column);
+    compares.push_back({&column, condition.op,
+                        SHEInt(column[0], (uint64_t)condition.value)});
+  }
+  // the compare of each group key, -1 for keys out of the column's range
+  std::vector<long> groupCompare;
+  for (int g=0; g < groups.size(); g++) {
+    if (!groupInRange[g]) {
+      groupCompare.push_back(-1);
+      continue;
+    }
+    const SHEVector<SHEInt> &column = input(groupColumn);
+    groupCompare.push_back(compares.size());
+    compares.push_back({&column, SHEQueryEQ,
+                        SHEInt(column[0], (uint64_t)groups[g])});
+  }
+  SHEVector<SHEInt> bits(zero, compares.size()*rows);
+  NTL_EXEC_RANGE(bits.size(), first, last)
+  for (long i=first; i < last; i++) {
+    const SHEQueryCompare &c = compares[i/rows];
+    bits[i] = compare((*c.column)[i%rows], c.op, c.constant);
+  }
+  NTL_EXEC_RANGE_END
+
+  // stage 2: AND the conditions of each row, then with each group
+  bits.verifyArgs();
+  std::vector<SHEInt> where(rows, SHEInt(pubKey, (uint64_t)1, 1, true));
+  if (conditions.size()) {
+    NTL_EXEC_RANGE(rows, first, last)
+    for (long r=first; r < last; r++) {
+      std::vector<SHEInt> terms;
+      for (int c=0; c < conditions.size(); c++) {
+        terms.push_back(bits[c*rows + r]);
+      }
+      where[r] = allTrue(terms);
+    }
+    NTL_EXEC_RANGE_END
+  }
+  if (groups.size() == 0) {
+    return where;
+  }
+  std::vector<SHEInt> mask(groups.size()*rows, zero);
+  NTL_EXEC_RANGE(mask.size(), first, last)
+  for (long i=first; i < last; i++) {
+    long c = groupCompare[i/rows];
+    if (c < 0) {
+      continue;
+    }
+    const SHEInt &inGroup = bits[c*rows + i%rows];
+    mask[i] = conditions.size() ? where[i%rows] && inGroup : inGroup;
+  }
+  NTL_EXEC_RANGE_END
+  return mask;
+}
+
+// the largest or smallest value of the column's type
+static SHEInt columnLimit(const SHEInt &model, bool largest)
+{
+  int valueBits = model.getSize() - (model.getUnsigned() ? 0 : 1);
+  uint64_t top = (valueBits >= 64) ? ~0ULL : (1ULL << valueBits)-1;
+  if (largest) {
+    return SHEInt(model, top);
+  }
+  // the signed minimum is the bits above top, truncated to the size
+  return SHEInt(model, model.getUnsigned() ? 0 : ~top);
+}
+
+// stage 3, one aggregate over one group
+SHEInt SHEQuery::aggregate(const SHEQuerySelect &select,
+                           const std::vector<SHEInt> &mask,
+                           const SHEInt &count) const
+{
+  if (select.aggregate == SHEQueryCount) {
+    return count;
+  }
+  const SHEVector<SHEInt> &column = table.getColumn(select.column);
+  const SHEInt &model = column[0];
+  if ((select.aggregate == SHEQueryMin) ||
+      (select.aggregate == SHEQueryMax)) {
+    bool isMax = select.aggregate == SHEQueryMax;
+    SHEInt identity(columnLimit(model, !isMax));
+    SHEVector<SHEInt> masked(model, 0);
+    for (int r=0; r < column.size(); r++) {
+      masked.push_back(mask[r].select(column[r], identity));
+    }
+    return isMax ? max(masked) : min(masked);
+  }
+  // SUM and AVG, wide enough to hold the sum of every row
+  int size = model.getSize() + SHEInt::getBitSize(column.size());
+  std::vector<SHEInt> values;
+  for (auto &value : column) {
+    values.push_back(value);
+    values.back().reset(size, value.getUnsigned());
+  }
+  SHEInt sum(sumIf(values, mask));
+  if (select.aggregate == SHEQuerySum) {
+    return sum;
+  }
+  SHEInt divisor(count);
+  divisor.reset(size, true);
+  divisor.reset(size, sum.getUnsigned());
+  SHEInt average(count.isZero().select(SHEInt(sum, (uint64_t)0),
+                                       sum/divisor));
+  average.reset(model.getSize(), model.getUnsigned());
+  return average;
+}
+
+std::vector<SHEBool> SHEQuery::rows(void) const
+{
+  helib::assertTrue(groups.size() == 0, "rows() of a grouped query");
+  std::vector<SHEInt> mask(rowMasks());
+  return std::vector<SHEBool>(mask.begin(), mask.end());
+}
+
+SHEQueryResult SHEQuery::run(void) const
+{
+  helib::assertTrue(selects.size() > 0, "query doesn't select anything");
+  size_t rows = table.getRows();
+  size_t groupCount = groups.size() ? groups.size() : 1;
+  bool needCount = false;
+  for (auto &select : selects) {
+    needCount = needCount || (select.aggregate == SHEQueryCount) ||
+                (select.aggregate == SHEQueryAvg);
+  }
+  if (log) {
+    (*log) << "SHEQuery rows=" << rows << " conditions=" << conditions.size()
+           << " groups=" << groupCount << " selects=" << selects.size()
+           << std::endl;
+  }
+  std::vector<SHEInt> flat(rowMasks());
+  SHEVector<SHEInt> packed(flat[0], 0);
+  for (auto &bit : flat) {
+    packed.push_back(bit);
+  }
+  packed.verifyArgs();
+
+  SHEQueryResult result(groupCount);
+  NTL_EXEC_RANGE(groupCount, first, last)
+  for (long g=first; g < last; g++) {
+    std::vector<SHEInt> mask(packed.begin()+g*rows,
+                             packed.begin()+(g+1)*rows);
+    SHEInt count(mask[0]);
+    if (needCount) {
+      count = countTrue(mask);
+    }
+    for (auto &select : selects) {
+      result[g].push_back(aggregate(select, mask, count));
+    }
+  }
+  NTL_EXEC_RANGE_END
+  return result;
+}
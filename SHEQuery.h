@@ -0,0 +1,149 @@
+//
+// a small SQL like query layer over encrypted columns
+//
+#ifndef SHEQuery_H_
+#define SHEQuery_H_ 1
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "SHEInt.h"
+#include "SHEVector.h"
+
+//
+// A SHETable is a set of named, equal length SHEInt columns. A SHEQuery
+// is built up much like
+//
+//   SELECT SUM(price), COUNT(*) FROM table WHERE qty > 10 AND qty <= 100
+//       GROUP BY region IN (1, 2, 3)
+//
+// as
+//
+//   SHEQuery(table).select(SHEQuerySum, "price").select(SHEQueryCount)
+//       .where("qty", SHEQueryGT, 10).where("qty", SHEQueryLE, 100)
+//       .groupBy("region", {1, 2, 3}).run();
+//
+// WHERE conditions are ANDed. GROUP BY takes the list of group keys in the
+// clear, since the result has to have a fixed shape; rows whose key isn't
+// in the list aren't in any group.
+//
+// Constants are checked against the range of their column's type. A
+// condition whose constant is outside that range is decided in the clear
+// (qty > -1 on an unsigned column is always true): an always true
+// condition is dropped, an always false one makes every row mask an
+// explicit zero. A group key outside the range gets an explicit zero mask.
+//
+// run() plans the whole query as one circuit in stages:
+//   1. every distinct condition, and the group key compares, on every row
+//      (each is computed once no matter how many times the query uses it)
+//   2. the per row mask for each group, an AND of its conditions
+//   3. the aggregates: COUNT is a carry save count of the mask bits, SUM
+//      masks the values into one multi-operand adder (see sumIf()), MIN and
+//      MAX replace the masked out rows with the identity and run a
+//      tournament, AVG is SUM/COUNT.
+// The inputs of each stage are brought up to capacity together in one
+// packed recrypt, rather than letting each operator recrypt on its own.
+// The compares, the row ANDs and the groups each run on the NTL thread
+// pool (see SHEInt::setThreads()).
+//
+// SUM is widened to hold the sum of every row. MIN and MAX of an empty
+// group return the largest or smallest value of the column's type, and AVG
+// of an empty group is 0.
+//
+enum SHEQueryOp {
+  SHEQueryEQ,
+  SHEQueryNE,
+  SHEQueryLT,
+  SHEQueryLE,
+  SHEQueryGT,
+  SHEQueryGE
+};
+
+enum SHEQueryAggregate {
+  SHEQueryCount,
+  SHEQuerySum,
+  SHEQueryAvg,
+  SHEQueryMin,
+  SHEQueryMax
+};
+
+class SHETable {
+private:
+  std::vector<std::string> names;
+  std::vector<SHEVector<SHEInt>> columns;
+
+public:
+  SHETable(void) {}
+  SHETable(const SHETable &a) : names(a.names), columns(a.columns) {}
+  void addColumn(const std::string &name, const SHEVector<SHEInt> &column);
+  template<class T>
+  void addColumn(const std::string &name, const SHEVector<T> &column)
+  {
+    SHEVector<SHEInt> wide(column[0], 0);
+    for (auto &value : column) {
+      wide.push_back(value);
+    }
+    addColumn(name, wide);
+  }
+  const SHEVector<SHEInt> &getColumn(const std::string &name) const;
+  bool hasColumn(const std::string &name) const;
+  size_t getRows(void) const
+  { return columns.size() ? columns[0].size() : 0; }
+  size_t getColumns(void) const { return columns.size(); }
+  const SHEPublicKey &getPublicKey(void) const;
+};
+
+struct SHEQueryCondition {
+  std::string column;
+  SHEQueryOp op;
+  int64_t value;
+  bool operator==(const SHEQueryCondition &a) const
+  { return (column == a.column) && (op == a.op) && (value == a.value); }
+};
+
+struct SHEQuerySelect {
+  SHEQueryAggregate aggregate;
+  std::string column;        // not used by COUNT
+};
+
+// result[group][select], one group if there is no GROUP BY
+typedef std::vector<std::vector<SHEInt>> SHEQueryResult;
+
+class SHEQuery {
+private:
+  static std::ostream *log;
+  const SHETable &table;
+  std::vector<SHEQueryCondition> conditions;
+  std::vector<SHEQuerySelect> selects;
+  std::string groupColumn;
+  std::vector<int64_t> groups;
+  std::vector<bool> groupInRange;
+  bool whereFalse = false;     // some condition is false on every row
+
+  std::vector<SHEInt> rowMasks(void) const;
+  SHEInt aggregate(const SHEQuerySelect &select,
+                   const std::vector<SHEInt> &mask,
+                   const SHEInt &count) const;
+
+public:
+  SHEQuery(const SHETable &table_) : table(table_) {}
+  SHEQuery(const SHEQuery &a) : table(a.table), conditions(a.conditions),
+           selects(a.selects), groupColumn(a.groupColumn),
+           groups(a.groups), groupInRange(a.groupInRange),
+           whereFalse(a.whereFalse) {}
+
+  SHEQuery &select(SHEQueryAggregate aggregate,
+                   const std::string &column="");
+  SHEQuery &where(const std::string &column, SHEQueryOp op, int64_t value);
+  SHEQuery &groupBy(const std::string &column,
+                    const std::vector<int64_t> &groups_);
+
+  // the WHERE mask, one encrypted bool per row (SELECT * WHERE ...)
+  std::vector<SHEBool> rows(void) const;
+  SHEQueryResult run(void) const;
+
+  static void setLog(std::ostream &str) { log = &str; }
+  static void clearLog(void) { log = nullptr; }
+};
+
+#endif
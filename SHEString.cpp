@@ -12,8 +12,7 @@
 SHEPrivateKey *SHEString::debugPrivKey = nullptr; // set for debugging
 #endif
 std::ostream *SHEString::log = nullptr;
-uint64_t SHEString::nextTmp = 0;
-SHEStringLabelHash SHEString::labelHash;
+std::atomic<uint64_t> SHEString::nextTmp(0);
 const size_t SHEString::npos;
 const size_t SHEString::maxEncryptStringSize;
 size_t SHEString::maxStringSize = 32;
@@ -30,7 +29,7 @@ SHEString::SHEString(const SHEPublicKey &pubKey, const char *string_,
                      eLen(pubKey, (uint8_t)0),
                      hasEncryptedLength(hasEncryptedLength_)
 {
-  if (label) labelHash[this] = label;
+  if (label) labelPtr = label;
   size_t len = strlen(string_);
   string.resize(len);
   for (size_t i=0; i < len ; i++) {
@@ -46,7 +45,7 @@ SHEString::SHEString(const SHEPublicKey &pubKey, const std::string &string_,
                      eLen(pubKey, (uint8_t)0),
                      hasEncryptedLength(hasEncryptedLength_)
 {
-  if (label) labelHash[this] = label;
+  if (label) labelPtr = label;
   size_t len = string_.size();
   string.resize(len);
   for (size_t i=0; i < len ; i++) {
@@ -63,7 +62,7 @@ SHEString::SHEString(const SHEString &model_, const char *string_,
                      eLen(model_.eLen, (uint8_t)0),
                      hasEncryptedLength(hasEncryptedLength_)
 {
-  if (label) labelHash[this] = label;
+  if (label) labelPtr = label;
   size_t len = strlen(string_);
   string.resize(len);
   for (size_t i=0; i < len ; i++) {
@@ -80,7 +79,7 @@ SHEString::SHEString(const SHEString &model_, const char *string_, size_t n,
                      eLen(model_.eLen, (uint8_t)0),
                      hasEncryptedLength(hasEncryptedLength_)
 {
-  if (label) labelHash[this] = label;
+  if (label) labelPtr = label;
   string.resize(n);
   for (size_t i=0; i < n ; i++) {
     string[i] = string_[i];
@@ -96,7 +95,7 @@ SHEString::SHEString(const SHEString &model_, const std::string &string_,
                      eLen(model_.eLen, (uint8_t)0),
                      hasEncryptedLength(hasEncryptedLength_)
 {
-  if (label) labelHash[this] = label;
+  if (label) labelPtr = label;
   size_t len = string_.size();
   string.resize(len);
   for (size_t i=0; i < len ; i++) {
@@ -114,7 +113,7 @@ SHEString::SHEString(size_t n, const SHEChar &c, bool hasEncryptedLength_,
                      eLen(c, (uint8_t)0),
                      hasEncryptedLength(hasEncryptedLength_)
 {
-  if (label) labelHash[this] = label;
+  if (label) labelPtr = label;
   string.resize(n, c);
   if (hasEncryptedLength) {
     encryptLength(true);
@@ -127,7 +126,7 @@ SHEString::SHEString(const SHEInt &n, const SHEChar &c,
                      eLen(c, (uint8_t)0),
                      hasEncryptedLength(true)
 {
-  if (label) labelHash[this] = label;
+  if (label) labelPtr = label;
   size_t maxSize = hasFixedSize ? maxStringSize : maxEncryptStringSize;
   string.resize(maxSize, c);
   eLen = SHEMIN(n,maxSize);
@@ -139,7 +138,7 @@ SHEString::SHEString(const SHEChar &model_, size_t n, char c,
                      eLen(model_, (uint8_t)0),
                      hasEncryptedLength(hasEncryptedLength_)
 {
-  if (label) labelHash[this] = label;
+  if (label) labelPtr = label;
   string.resize(n, SHEChar(model, c));
   if (hasEncryptedLength) {
     encryptLength(true);
@@ -151,7 +150,7 @@ SHEString::SHEString(const SHEInt &n, char c, const char *label) :
                      eLen(n, (uint8_t)0),
                      hasEncryptedLength(true)
 {
-  if (label) labelHash[this] = label;
+  if (label) labelPtr = label;
   size_t maxSize = hasFixedSize ? maxStringSize : maxEncryptStringSize;
   string.resize(maxSize, SHEChar(model, c));
   eLen = SHEMIN(n,maxSize);
@@ -13,7 +13,6 @@
 typedef SHEUInt8 SHEChar;
 
 class SHEString;
-typedef std::unordered_map<const SHEString *,const char *>SHEStringLabelHash;
 
 class SHEString {
 private:
@@ -22,8 +21,7 @@ private:
   static SHEPrivateKey *debugPrivKey; // set for debugging
 #endif
   static std::ostream *log;
-  static uint64_t nextTmp;
-  static SHEStringLabelHash labelHash;
+  static std::atomic<uint64_t> nextTmp;
   static const size_t npos = (1<<16)-1;
   static const size_t maxEncryptStringSize = 255;
   static size_t maxStringSize;
@@ -33,6 +31,7 @@ private:
   SHEUInt8   eLen;
   bool       hasEncryptedLength;
   char labelBuf[SHEINT_MAX_LABEL_SIZE];
+  mutable const char *labelPtr = nullptr; // label, labelBuf or nullptr
   void encryptLengthReset(const SHEInt &len)
   {
     if (hasFixedSize) {
@@ -52,19 +51,18 @@ private:
   {
     uint64_t current=nextTmp++;
     snprintf((char *)&labelBuf[0], sizeof(labelBuf), "t%d",current);
-    labelHash[this]=labelBuf;
+    labelPtr=labelBuf;
     return labelBuf;
   }
 public:
   static constexpr std::string_view typeName = "SHEString";
-  ~SHEString(void) { labelHash.erase(this); }
   // 'default' constructor, needs a public key
   explicit SHEString(const SHEPublicKey &pubKey, bool hasEncryptedLength=false,
                      const char *label=nullptr) :
                      model(pubKey,(uint8_t)0), string(model, 0),
                      eLen(pubKey,(uint8_t)0),
                      hasEncryptedLength(hasEncryptedLength)
-  { if (label) labelHash[this] = label; }
+  { if (label) labelPtr = label; }
   // copy constructer
   SHEString(const SHEString &s) :
             model(s.model), string(s.string),
@@ -73,7 +71,7 @@ public:
   SHEString(const SHEString &s, int dummy, const char *label) :
             model(s.model), string(s.string),
             eLen(s.eLen), hasEncryptedLength(s.hasEncryptedLength)
-  { labelHash[this] = label; }
+  { labelPtr = label; }
   SHEString &operator=(const SHEString &s) {
     model = s.model; string = s.string; eLen= s.eLen;
     hasEncryptedLength = s.hasEncryptedLength;
@@ -118,7 +116,7 @@ public:
   }
   const char *getLabel(void) const
   {
-    const char *label = labelHash[this];
+    const char *label = labelPtr;
     if (label) return label;
     return setNextLabel();
   }
@@ -2,15 +2,22 @@
 // Test program for Simple Homomorphic Encryption
 //
 #include <iostream>
+#include <algorithm>
+#include <map>
 #include "SHEKey.h"
 #include "SHEInt.h"
 #include "SHETime.h"
 #include "SHEVector.h"
 #include "SHEFp.h"
 #include "SHEMath.h"
+#include "SHEFunctionTable.h"
+#include "SHELinear.h"
+#include "SHEAlgorithm.h"
+#include "SHEQuery.h"
+#include "SHEControl.h"
 #include "getopt.h"
 
-#define NUM_TESTS 22
+#define NUM_TESTS 41
 #define FLOAT_TESTS 24
 
 // config options now just set the defaults
@@ -49,6 +56,7 @@ static struct option longOptions[] =
    { "no-log", no_argument, &doLog, false },
    { "security-level", required_argument, 0, 's' },
    { "capacity", required_argument, 0, 'c' },
+   { "threads", required_argument, 0, 'j' },
    { 0, 0, 0, 0 }
 };
 
@@ -256,6 +264,46 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
   r[19] = (int16_t) fb;
   r[20] = (bool)(fa > fb);
   r[21] = (bool)(fc < fd);
+  r[22] = i*i/4 - i;
+  r[23] = __builtin_popcount((uint16_t)a);
+  r[24] = (a < 0) ? 0 : (int16_t)std::sqrt((double)a);
+  r[25] = __builtin_parity((uint16_t)b);
+  r[26] = a*c + b*d;
+  r[27] = std::max(std::min(a,b), std::min(std::max(a,b),c));
+  r[28] = std::max(std::max(a,b),c);
+  r[29] = a+b+c;
+  r[30] = (a > z ? a : 0) + (b > z ? b : 0) + (c > z ? c : 0);
+  std::map<int16_t,int16_t> brackets = {{-100,10},{0,20},{500,30},{1500,40}};
+  auto bracket = brackets.upper_bound(a);
+  r[31] = (bracket == brackets.begin()) ? z : std::prev(bracket)->second;
+  r[32] = INT16_MIN;
+  for (auto x : { a, b, c }) {
+    if (x < d) {
+      r[32] = std::max(r[32], x);
+    }
+  }
+  r[33] = (a < 0) + (b < 0) + (c < 0);
+  int16_t x = a, y = b;
+  if (x < y) {
+    x = y - x;
+  } else {
+    y = y - x;
+  }
+  r[34] = x - y;
+  x = a;
+  for (int i=0; i < 3; i++) {
+    x = (x >> 1) + c;
+  }
+  r[35] = x;
+  r[36] = 0;    // argmax of a single element
+  r[37] = std::max(std::max(a,b), c);
+  // int keys, wider than the encrypted key
+  std::vector<int> wideKeys = { -100, 0, 500, 1500, 2000 };
+  r[38] = std::lower_bound(wideKeys.begin(), wideKeys.end(), 1800)
+          - wideKeys.begin();
+  // query constants outside the column's range
+  r[39] = (a < 65516) + (b < 65516) + (c < 65516);
+  r[40] = 0;
 
   // unsigned equivalences
   ur[z] = ub;
@@ -287,6 +335,47 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
   ur[19] = (uint16_t) fb;
   ur[20] = (bool)(fa > fb);
   ur[21] = (bool)(fc < fd);
+  ur[22] = ((ui|0x20) >= 'a') && ((ui|0x20) <= 'z');
+  ur[23] = ua ? __builtin_clz(ua) - 16 : 16;
+  ur[24] = ua ? __builtin_ctz(ua) : 16;
+  ur[25] = 0;
+  for (int bit=0; bit < 16; bit++) {
+    ur[25] |= ((ub >> bit) & 1) << (15-bit);
+  }
+  ur[26] = ua*3 + ub*5;
+  ur[27] = std::max(std::max(ua,ub), std::max(uc,ud));
+  ur[28] = 0;
+  uint16_t u4[4] = { ua, ub, uc, ud };
+  for (int i=1; i < 4; i++) {
+    if (u4[i] < u4[ur[28]]) {
+      ur[28] = i;
+    }
+  }
+  ur[29] = std::max(std::max(uz,ua), std::max(ub,uc));
+  ur[30] = (a > z) + (b > z) + (c > z);
+  std::vector<uint16_t> tiers = { 10, 100, 1000, 5000 };
+  ur[31] = std::lower_bound(tiers.begin(), tiers.end(), ua) - tiers.begin();
+  ur[32] = (ua & 1)*ua + (ub & 1)*ub + (uc & 1)*uc + (ud & 1)*ud;
+  ur[33] = 0;
+  for (auto x : { ua, ub, uc, ud }) {
+    ur[33] += (x >= 100) && (x < 1000);
+  }
+  ur[34] = (ua & 2) ? ua*3 + 1 : ua >> 1;
+  uint16_t ux = ub, uy = ua;
+  while (ux < uy) {
+    ux += 1;
+    uy >>= 1;
+  }
+  ur[35] = ux + uy;
+  ur[36] = 0;
+  ur[37] = ua | ub | uc;
+  std::map<int,int> wideBrackets = {{-100,10},{0,20},{500,30},{1500,40},
+                                    {2000,50}};
+  auto wideBracket = wideBrackets.upper_bound(a);
+  ur[38] = (wideBracket == wideBrackets.begin()) ? uz
+           : std::prev(wideBracket)->second;
+  ur[39] = 4;
+  ur[40] = (ua & 1) + (ub & 1) + (uc & 1) + (ud & 1);
 
   if (doFloat) {
     // floating point operations
@@ -337,6 +426,46 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
     fr[22] = modff(fb,&fr[23]);
   }
 
+  // function tables: a signed polynomial, and digit and letter classes
+  // read from one decode
+  SHEFunctionTable square([](int64_t x) { return x*x/4 - x; },
+                          8, 16, false, false);
+  SHEFunctionTable charClass([](int64_t x) {
+      return std::vector<int64_t>{(x >= '0') && (x <= '9'),
+                                  ((x|0x20) >= 'a') && ((x|0x20) <= 'z')}; },
+      2, 8, 1);
+  // dot products
+  SHEVector<SHEInt16> row(ea,2), column(ec,2);
+  row[1] = eb;
+  column[1] = ed;
+  SHEVector<SHEUInt16> urow(eua,2);
+  urow[1] = eub;
+  // sorting networks
+  SHEVector<SHEInt16> three(ea,3);
+  three[1] = eb;
+  three[2] = ec;
+  SHEVector<SHEUInt16> four(eua,4);
+  four[1] = eub;
+  four[2] = euc;
+  four[3] = eud;
+  SHEVector<SHEInt16> one(ea,1);
+  // scans with a lambda
+  auto scanMax = [](const SHEInt16 &x, const SHEInt16 &y)
+                 { return SHEInt16((x < y).select(y, x)); };
+  auto scanOr = [](const SHEUInt16 &x, const SHEUInt16 &y)
+                { return SHEUInt16(x | y); };
+  std::vector<SHEBool> positive = { ea > ez, eb > ez, ec > ez };
+  // queries
+  SHETable signedTable;
+  signedTable.addColumn("value", three);
+  SHEVector<SHEUInt16> parity(eua & 1, 4);
+  parity[1] = eub & 1;
+  parity[2] = euc & 1;
+  parity[3] = eud & 1;
+  SHETable unsignedTable;
+  unsignedTable.addColumn("value", four);
+  unsignedTable.addColumn("parity", parity);
+
   //Time the encrypted operations
   std::cout << "-------------- encrypted math tests"  << std::endl;
   std::cout << "..sign ints"  << std::endl;
@@ -378,6 +507,38 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
                  eur[19] = (SHEUInt16) efb)
   RUN_TEST(er[20], r[20], er[20] = (SHEUInt16) (efa > efb))
   RUN_TEST(er[21], r[21], er[21] = (SHEUInt16) (efc < efd))
+  RUN_TEST(er[22], r[22], er[22] = square.evaluate(ei, 0, SHETableMuxTree))
+  RUN_TEST(er[23], r[23], er[23] = ea.popcount())
+  RUN_TEST(er[24], r[24], er[24] = ea.isqrt())
+  RUN_TEST(er[25], r[25], er[25] = eb.parity())
+  RUN_TEST(er[26], r[26], er[26] = dot(row, column))
+  RUN_TEST(er[27], r[27], er[27] = median(three))
+  RUN_TEST(er[28], r[28], er[28] = max(three))
+  RUN_TEST(er[29], r[29], er[29] = inclusiveScan(three)[2])
+  RUN_TEST(er[30], r[30], er[30] = sum_if(three, positive))
+  RUN_TEST(er[31], r[31], er[31] = getRange(ez, brackets, ea))
+  RUN_TEST(er[32], r[32], er[32] = SHEQuery(signedTable)
+           .select(SHEQueryMax, "value").where("value", SHEQueryLT, d)
+           .run()[0][0])
+  RUN_TEST(er[33], r[33], er[33] = histogram(three, std::vector<int16_t>{0})[0])
+  SHEInt16 ex(ea), ey(eb);
+  RUN_TEST(er[34], r[34], SHEIf(ex < ey,
+           [&](SHEIf &when) { when.assign(ex, ey - ex); },
+           [&](SHEIf &when) { when.assign(ey, ey - ex); });
+           er[34] = ex - ey)
+  ex = ea;
+  RUN_TEST(er[35], r[35], SHELoop(3, { &ex })
+           .repeat([&](int i) { ex = (ex >> 1) + ec; });
+           er[35] = ex)
+  RUN_TEST(er[36], r[36], er[36] = argmax(one))
+  RUN_TEST(er[37], r[37], er[37] = inclusiveScan(three, scanMax)[2])
+  RUN_TEST(er[38], r[38], er[38] = lowerBound(wideKeys, SHEInt16(ez, 1800)))
+  RUN_TEST(er[39], r[39], er[39] = SHEQuery(signedTable)
+           .select(SHEQueryCount).where("value", SHEQueryLT, 65516)
+           .run()[0][0])
+  RUN_TEST(er[40], r[40], er[40] = SHEQuery(signedTable)
+           .select(SHEQueryCount).groupBy("value", {b, 65536 + b})
+           .run()[1][0])
 
   std::cout << "..unsign ints"  << std::endl;
   RUN_TEST_ALIAS(eur[euz], ur[z], eur.assign(euz,eub), eur[euz] = eub)
@@ -418,6 +579,39 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
                  eur[19] = (SHEUInt16) efb)
   RUN_TEST(eur[20], ur[20], eur[20] = efa > efb)
   RUN_TEST(eur[21], ur[21], eur[21] = efc < efd)
+  RUN_TEST(eur[22], ur[22], eur[22] = charClass.evaluateAll(eui)[1])
+  RUN_TEST(eur[23], ur[23], eur[23] = eua.clz())
+  RUN_TEST(eur[24], ur[24], eur[24] = eua.ctz())
+  RUN_TEST(eur[25], ur[25], eur[25] = eub.bitReverse())
+  RUN_TEST(eur[26], ur[26], eur[26] = dot(urow, std::vector<int64_t>{3,5}))
+  RUN_TEST(eur[27], ur[27], eur[27] = topK(four, 1)[0])
+  RUN_TEST(eur[28], ur[28], eur[28] = argmin(four))
+  RUN_TEST(eur[29], ur[29], eur[29] = exclusiveScan(four, euz, SHEScanMax)[3])
+  RUN_TEST(eur[30], ur[30], eur[30] = count_if(positive))
+  RUN_TEST(eur[31], ur[31], eur[31] = lowerBound(tiers, eua))
+  RUN_TEST(eur[32], ur[32], eur[32] = SHEQuery(unsignedTable)
+           .select(SHEQuerySum, "value").groupBy("parity", {0, 1})
+           .run()[1][0])
+  RUN_TEST(eur[33], ur[33], eur[33] = histogram(four,
+                                        std::vector<uint16_t>{100, 1000})[1])
+  eur[34] = eua;
+  RUN_TEST(eur[34], ur[34], SHEIf when(eua.getBit(1));
+           when.assign(eur[34], eua*3 + 1, eua >> 1); when.commit())
+  SHEUInt16 eux(eub), euy(eua);
+  RUN_TEST(eur[35], ur[35], SHELoop(eua.getSize()+1, { &eux, &euy })
+           .run([&]() { return eux < euy; },
+                [&](SHEIf &when) { when.assign(eux, eux + 1);
+                                   when.assign(euy, euy >> 1); });
+           eur[35] = eux + euy)
+  RUN_TEST(eur[36], ur[36], eur[36] = argmin(SHEVector<SHEUInt16>(eua,1)))
+  RUN_TEST(eur[37], ur[37], eur[37] = exclusiveScan(four, euz, scanOr)[3])
+  RUN_TEST(eur[38], ur[38], eur[38] = getRange(euz, wideBrackets, ea))
+  RUN_TEST(eur[39], ur[39], eur[39] = SHEQuery(unsignedTable)
+           .select(SHEQueryCount).where("value", SHEQueryGT, -1)
+           .run()[0][0])
+  RUN_TEST(eur[40], ur[40], eur[40] = SHEQuery(unsignedTable)
+           .select(SHEQueryCount).groupBy("parity", {65537, 1})
+           .run()[1][0])
 
   if (doFloat) {
     std::cout << "..floats "  << std::endl;
@@ -537,6 +731,125 @@ do_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
 }
 
 
+// SHEFpT formats other than the one do_tests uses. The inputs are exact
+// in each format, and so are the expected results.
+#define CUSTOM_TESTS 5
+#define E4M3_TESTS 4
+#define E5M2_TESTS 3
+#define FORMAT_TESTS (CUSTOM_TESTS+E4M3_TESTS+E5M2_TESTS)
+typedef SHEFpT<6,11,float> SHEFp6E11;
+
+void
+do_format_tests(const SHEPublicKey &pubkey, SHEPrivateKey &privkey,
+                int &failed, int &tests)
+{
+  float fr[FORMAT_TESTS];
+  float dfr[FORMAT_TESTS];
+  int16_t r[2], dr[2];
+  Timer timer;
+  float ca = 6.25, cb = -1.75, cc = 1048576.0;
+  float e4a = 1.5, e4b = 3.0, e4c = 96.0, e4d = 2.0;
+  float e5a = 1.5, e5b = 2.0;
+
+  // a 16 bit float with more range than half float: ca*cc is past
+  // the half float max
+  fr[0] = ca + cb;
+  fr[1] = ca - cb;
+  fr[2] = ca * cb;
+  fr[3] = (ca > cb) ? ca*cb : ca+cb;
+  fr[4] = ca * cc;
+  r[0] = (int16_t) (ca * cb);
+  // 8 bit floats take the table normalize and the lookup multiply.
+  // e4b - e4a needs a normalize shift, e4c * e4d is past the E4M3 max
+  // of 120
+  fr[5] = e4a * e4b;
+  fr[6] = e4a + e4b;
+  fr[7] = e4b - e4a;
+  fr[8] = INFINITY;
+  fr[9] = e5a * e5b;
+  fr[10] = e5a + e5b;
+  fr[11] = (e5a < e5b) ? e5b : e5a;
+  r[1] = (int16_t) (e5a * e5b);
+
+  std::cout << "------------------------ custom format SHEFpT<6,11>"
+            << std::endl;
+  SHEFp6E11 eca(pubkey, ca, "ca");
+  SHEFp6E11 ecb(pubkey, cb, "cb");
+  SHEFp6E11 ecc(pubkey, cc, "cc");
+  std::vector<SHEFp6E11> ecr(CUSTOM_TESTS, SHEFp6E11(pubkey, 0.0));
+  std::vector<SHEInt16> er(2, SHEInt16(pubkey, 0, "r"));
+  RUN_TEST(ecr[0], fr[0], ecr[0] = eca + ecb)
+  RUN_TEST(ecr[1], fr[1], ecr[1] = eca - ecb)
+  RUN_TEST(ecr[2], fr[2], ecr[2] = eca * ecb)
+  RUN_TEST_ALIAS(ecr[3], fr[3], ecr[3] = select(eca > ecb, eca*ecb, eca+ecb),
+                 ecr[3] = (eca > ecb) ? eca*ecb : eca+ecb)
+  RUN_TEST(ecr[4], fr[4], ecr[4] = eca * ecc)
+  RUN_TEST_ALIAS(er[0], r[0], er[0] = (SHEInt16) ecr[2],
+                 er[0] = (int16_t) ecr[2])
+
+  std::cout << "------------------------ 8 bit floats" << std::endl;
+  SHEFloat8E4M3 ee4a(pubkey, e4a, "e4a");
+  SHEFloat8E4M3 ee4b(pubkey, e4b, "e4b");
+  SHEFloat8E4M3 ee4c(pubkey, e4c, "e4c");
+  SHEFloat8E4M3 ee4d(pubkey, e4d, "e4d");
+  SHEFloat8E5M2 ee5a(pubkey, e5a, "e5a");
+  SHEFloat8E5M2 ee5b(pubkey, e5b, "e5b");
+  std::vector<SHEFloat8E4M3> ee4r(E4M3_TESTS, SHEFloat8E4M3(pubkey, 0.0));
+  std::vector<SHEFloat8E5M2> ee5r(E5M2_TESTS, SHEFloat8E5M2(pubkey, 0.0));
+  RUN_TEST(ee4r[0], fr[5], ee4r[0] = ee4a * ee4b)
+  RUN_TEST(ee4r[1], fr[6], ee4r[1] = ee4a + ee4b)
+  RUN_TEST(ee4r[2], fr[7], ee4r[2] = ee4b - ee4a)
+  RUN_TEST(ee4r[3], fr[8], ee4r[3] = ee4c * ee4d)
+  RUN_TEST(ee5r[0], fr[9], ee5r[0] = ee5a * ee5b)
+  RUN_TEST(ee5r[1], fr[10], ee5r[1] = ee5a + ee5b)
+  RUN_TEST_ALIAS(ee5r[2], fr[11], ee5r[2] = select(ee5a < ee5b, ee5b, ee5a),
+                 ee5r[2] = (ee5a < ee5b) ? ee5b : ee5a)
+  RUN_TEST_ALIAS(er[1], r[1], er[1] = (SHEInt16) ee5r[0],
+                 er[1] = (int16_t) ee5r[0])
+
+  for (int i = 0; i < CUSTOM_TESTS; i++) {
+    dfr[i] = ecr[i].decrypt(privkey);
+  }
+  for (int i = 0; i < E4M3_TESTS; i++) {
+    dfr[CUSTOM_TESTS+i] = ee4r[i].decrypt(privkey);
+  }
+  for (int i = 0; i < E5M2_TESTS; i++) {
+    dfr[CUSTOM_TESTS+E4M3_TESTS+i] = ee5r[i].decrypt(privkey);
+  }
+  for (int i = 0; i < 2; i++) {
+    dr[i] = er[i].decrypt(privkey);
+  }
+
+  std::cout << "-------------decrypted outputs verse originals\n" << std::endl;
+  for (int i = 0; i < FORMAT_TESTS; i++) {
+    std::cout << "fr[" << i << "]=" << fr[i] << " dfr[" << i << "]="
+              << dfr[i] << " ";
+    if (FLOAT_CMP_EQ(fr[i],dfr[i])) {
+      std::cout << "PASS";
+    } else {
+      failed++; std::cout <<"FAIL";
+    }
+    tests++; std::cout << std::endl;
+  }
+  for (int i = 0; i < 2; i++) {
+    std::cout << "r[" << i << "]=" << r[i] << " dr[" << i << "]=" << dr[i]
+              << " ";
+    if (r[i] == dr[i]) {
+      std::cout << "PASS";
+    } else {
+      failed++; std::cout << "FAIL";
+    }
+    tests++; std::cout << std::endl;
+  }
+  std::cout << "E4M3 max=" << ee4a.getMax() << " ";
+  if (ee4a.getMax() == 120.0) {
+    std::cout << "PASS";
+  } else {
+    failed++; std::cout << "FAIL";
+  }
+  tests++; std::cout << std::endl;
+}
+
 int main(int argc, char **argv)
 {
   SHEPublicKey pubkey;
@@ -546,7 +859,7 @@ int main(int argc, char **argv)
   int tests = 0;
   long securityLevel = 19;
   long capacity = SHE_CONTEXT_CAPACITY_ANY;
-  const char *argString="TtDdFfLls:c:";
+  const char *argString="TtDdFfLls:c:j:";
 
   int carg;
 
@@ -586,6 +899,9 @@ int main(int argc, char **argv)
     case 'c':
       capacity = atoi(optarg);
       break;
+    case 'j':
+      SHEInt::setThreads(atoi(optarg));
+      break;
     default:
       break;
     }
@@ -777,6 +1093,9 @@ int main(int argc, char **argv)
                 1.001, M_PI/3.0, 2.5e-6, 1.4e+4,  fz, failed, tests);
   do_tests(pubkey, privkey, 2000, -89, -28, 8, z, 3,
                 1.001, M_PI/6.0+10*M_PI, 2.5e-6, 1.4e+4,  fz, failed, tests);
+  if (doFloat) {
+    do_format_tests(pubkey, privkey, failed, tests);
+  }
 
   std::cout << failed << " test" << (char *)((failed == 1) ? "" : "s")
             << " failed out of " << tests << " tests." << std::endl;
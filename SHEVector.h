@@ -6,6 +6,7 @@
 #define SHEVector_H_ 1
 #include <cstdint>
 #include <iostream>
+#include <map>
 #include <helib/helib.h>
 #include "SHEInt.h"
 #include "SHEUtil.h"
@@ -132,25 +133,29 @@ public:
     int i;
     // lump together up to 6 elements to take advantage of
     // packed recrypt.
-    for (int i=5; i < narrow.size(); i+=6) {
+    for (i=5; i < narrow.size(); i+=6) {
       narrow[i].reCrypt(narrow[i-1],narrow[i-2],narrow[i-3],
                         narrow[i-4],narrow[i-5]);
     }
-    switch (i - narrow.size()) {
+    // the last narrow.size()-first elements are left over
+    int first = i-5;
+    switch (narrow.size() - first) {
     case 5:
-      narrow[i].reCrypt(narrow[i-4], narrow[i-3], narrow[i-2], narrow[i-1]);
+      narrow[first].reCrypt(narrow[first+1], narrow[first+2],
+                            narrow[first+3], narrow[first+4]);
       break;
     case 4:
-      narrow[i].reCrypt(narrow[i-3], narrow[i-2], narrow[i-1]);
+      narrow[first].reCrypt(narrow[first+1], narrow[first+2],
+                            narrow[first+3]);
       break;
     case 3:
-      narrow[i].reCrypt(narrow[i-2], narrow[i-1]);
+      narrow[first].reCrypt(narrow[first+1], narrow[first+2]);
       break;
     case 2:
-      narrow[i].reCrypt(narrow[i-1]);
+      narrow[first].reCrypt(narrow[first+1]);
       break;
     case 1:
-      narrow[i].reCrypt();
+      narrow[first].reCrypt();
       break;
     case 0:
       break;
@@ -309,4 +314,99 @@ inline EncryptedValue getMap(const EncryptedValue &_default,
   return retVal;
 }
 
+// select entry[index] by folding the entries in half on each bit of the
+// index, starting at bit low. n entries take n-1 selects and log2(n) levels
+// with no compares. Indexes past the end get the last entry.
+template<class Encrypted>
+inline Encrypted sheMuxTree(std::vector<Encrypted> entry, const SHEInt &index,
+                            int low=0)
+{
+  for (int bit=low; entry.size() > 1; bit++) {
+    if (entry.size() & 1) {
+      entry.push_back(entry.back());
+    }
+    SHEInt sel(index.getBit(bit));
+    std::vector<Encrypted> next;
+    for (int i=0; i < entry.size(); i += 2) {
+      next.push_back(select(sel, entry[i+1], entry[i]));
+    }
+    entry = next;
+  }
+  return entry[0];
+}
+
+// search a sorted unencrypted vector for an encrypted key. This is a
+// branchless binary search: the result is built a bit at a time from the
+// top, and the pivot for each bit is picked from the unencrypted keys by a
+// mux tree on the bits already found. That is one compare per bit,
+// log2(n) in all, rather than a compare per entry. The table is padded to
+// 2^bits-1 entries with the last key, which has to fit the encrypted key
+// where a type maximum might not (an int table with SHEInt16 keys).
+template<class EncryptedKey, class UnencryptedKey>
+inline SHEInt sheBinarySearch(const std::vector<UnencryptedKey> &keys,
+                              const EncryptedKey &searchKey, bool upper)
+{
+  int bits = SHEInt::getBitSize(keys.size());
+  SHEInt pos(searchKey.getPublicKey(), (uint64_t)0, bits, true);
+  if (keys.size() == 0) {
+    return pos;
+  }
+  std::vector<UnencryptedKey> padded(keys);
+  padded.resize((1ULL << bits)-1, keys.back());
+  for (int k=bits-1; k >= 0; k--) {
+    std::vector<EncryptedKey> pivot;
+    for (uint64_t j=0; j < (1ULL << (bits-1-k)); j++) {
+      pivot.push_back(EncryptedKey(searchKey,
+                                   padded[(j << (k+1)) + (1ULL << k) - 1]));
+    }
+    EncryptedKey p(sheMuxTree(pivot, pos, k+1));
+    pos.setBit(k, upper ? !(searchKey < p) : p < searchKey);
+  }
+  if (padded.size() != keys.size()) {
+    // a search past the last key can run into the padding
+    pos = select(pos > (uint64_t)keys.size(), (uint64_t)keys.size(), pos);
+    pos.reset(bits, true);
+  }
+  return pos;
+}
+
+// the index of the first key not less than searchKey (keys.size() if
+// there isn't one), like std::lower_bound. keys must be sorted.
+template<class EncryptedKey, class UnencryptedKey>
+inline SHEInt lowerBound(const std::vector<UnencryptedKey> &keys,
+                         const EncryptedKey &searchKey)
+{ return sheBinarySearch(keys, searchKey, false); }
+
+// the index of the first key greater than searchKey, like
+// std::upper_bound. keys must be sorted.
+template<class EncryptedKey, class UnencryptedKey>
+inline SHEInt upperBound(const std::vector<UnencryptedKey> &keys,
+                         const EncryptedKey &searchKey)
+{ return sheBinarySearch(keys, searchKey, true); }
+
+// interval lookup in an unencrypted map: the value of the largest key that
+// is less than or equal to searchKey, or _default if searchKey is below
+// all the keys. The keys are the bottoms of the intervals, as in a table
+// of tax brackets or price tiers.
+//  EncryptedValue needs an EncryptedValue(const EncryptedValue &model,
+//  UnencryptedValue) constructor (SHEInt subclasses and SHEFp).
+template<class EncryptedKey,   class EncryptedValue,
+         class UnencryptedKey, class UnencryptedValue>
+inline EncryptedValue getRange(const EncryptedValue &_default,
+                               const std::map<UnencryptedKey,
+                                              UnencryptedValue> &a,
+                               const EncryptedKey &searchKey)
+{
+  std::vector<UnencryptedKey> keys;
+  std::vector<EncryptedValue> entry(1, _default);
+  for (const auto& [key,value] : a) {
+    keys.push_back(key);
+    entry.push_back(EncryptedValue(_default, value));
+  }
+  if (keys.size() == 0) {
+    return _default;
+  }
+  return sheMuxTree(entry, upperBound(keys, searchKey));
+}
+
 #endif